@@ -904,6 +904,7 @@ def get_blosc_plugin():
         "hdf5plugin.plugins.libh5blosc",
         sources=sources + prefix(
             hdf5_blosc_dir, ['blosc_filter.c', 'blosc_plugin.c']),
+        export_symbols=['blosc_set_nthreads'],
         extra_objects=get_zstd_clib('extra_objects'),
         include_dirs=include_dirs + [hdf5_blosc_dir],
         define_macros=define_macros,
@@ -991,6 +992,7 @@ def get_blosc2_plugin():
     return HDF5PluginExtension(
         "hdf5plugin.plugins.libh5blosc2",
         sources=sources + prefix(hdf5_blosc2_dir, ['blosc2_filter.c', 'blosc2_plugin.c']),
+        export_symbols=['blosc2_set_nthreads', 'decompress_b2nd_chunk_slice'],
         extra_objects=get_zstd_clib('extra_objects'),
         include_dirs=include_dirs + [hdf5_blosc2_dir],
         define_macros=define_macros,
@@ -1009,15 +1011,19 @@ def get_zstandard_plugin():
     """HDF5Plugin-Zstandard plugin build config"""
     zstandard_dir = 'src/HDF5Plugin-Zstandard'
 
+    # Built with its own multithreaded zstd, other plugins use the zstd library without threads
     return HDF5PluginExtension(
         "hdf5plugin.plugins.libh5zstd",
-        sources=[f'{zstandard_dir}/zstd_h5plugin.c'],
+        sources=[f'{zstandard_dir}/zstd_h5plugin.c'] + get_zstd_clib('sources'),
         extra_objects=get_zstd_clib('extra_objects'),
         include_dirs=[zstandard_dir] + get_zstd_clib('include_dirs'),
+        define_macros=[('ZSTD_MULTITHREAD', 1)] + get_zstd_clib('macros'),
+        extra_compile_args=get_zstd_clib('cflags') + ['-pthread'],
+        extra_link_args=['-pthread'],
     )
 
 
-PLUGIN_LIB_DEPENDENCIES['zstd'] = ('zstd',)
+PLUGIN_LIB_DEPENDENCIES['zstd'] = ()
 
 
 def get_bitshuffle_plugin():
@@ -1037,12 +1043,16 @@ def get_bitshuffle_plugin():
 
     return HDF5PluginExtension(
         "hdf5plugin.plugins.libh5bshuf",
+        export_symbols=[
+            'bshuf_get_simd',
+            'bshuf_decompress_range',
+            'bshuf_register_zstd_dict',
+        ],
         sources=prefix(bithsuffle_dir, [
             "bshuf_h5plugin.c",
             "bshuf_h5filter.c",
             "bitshuffle.c",
             "bitshuffle_core.c",
-            "iochain.c",
         ]),
         extra_objects=get_zstd_clib('extra_objects'),
         include_dirs=[bithsuffle_dir] + get_lz4_clib('include_dirs') + get_zstd_clib('include_dirs'),
@@ -1065,6 +1075,8 @@ def get_lz4_plugin():
         extra_compile_args = ['-Wno-error=implicit-function-declaration']
     else:
         extra_compile_args = []
+    extra_compile_args += ['-fopenmp', '/openmp']
+    extra_link_args = ['-fopenmp']
 
     libraries = ['Ws2_32'] if sys.platform == 'win32' else []
     libraries.extend(get_lz4_clib('libraries'))
@@ -1074,7 +1086,7 @@ def get_lz4_plugin():
         sources=['src/LZ4/H5Zlz4.c', 'src/LZ4/lz4_h5plugin.c'],
         include_dirs=get_lz4_clib('include_dirs'),
         extra_compile_args=extra_compile_args,
-        extra_link_args=get_lz4_clib('extra_link_args'),
+        extra_link_args=extra_link_args + get_lz4_clib('extra_link_args'),
         libraries=libraries,
     )
 
@@ -1,9 +1,58 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include "zstd_h5plugin.h"
 #include "zstd.h"
 
 #define ZSTD_FILTER 32015
 
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+/* Contexts reused for all the chunks processed by a thread, which avoids
+ * allocating and initializing the workspace for each chunk.
+ * They are not freed when the thread exits: a thread-exit destructor could
+ * run after the plugin is unloaded. This leaks at most one compression and
+ * one decompression context per thread which used the filter, each of them
+ * bounded by ZSTD_CTX_KEEP_MAX_SIZE. */
+static THREAD_LOCAL ZSTD_CCtx *zstd_cctx = NULL;
+static THREAD_LOCAL ZSTD_DCtx *zstd_dctx = NULL;
+
+/* Contexts bigger than this, e.g., after using large windows, long
+ * distance matching or many workers, are freed after use rather than kept.
+ * A kept multithreaded compression context also keeps its worker threads. */
+#define ZSTD_CTX_KEEP_MAX_SIZE (32 * 1024 * 1024)
+
+/* Check options when the dataset is created, rather than failing when
+ * compressing chunks, which stores them uncompressed for an optional filter. */
+static htri_t zstd_can_apply(hid_t dcpl_id, hid_t type_id, hid_t space_id)
+{
+	unsigned int flags;
+	size_t cd_nelmts = 5;
+	unsigned int cd_values[5] = {0, 0, 0, 0, 0};
+
+	if (H5Pget_filter_by_id2(dcpl_id, ZSTD_FILTER, &flags, &cd_nelmts, cd_values, 0, NULL, NULL) < 0)
+		return -1;
+	if (cd_nelmts > 1 && cd_values[1] > 0 &&
+		(int)cd_values[1] > ZSTD_cParam_getBounds(ZSTD_c_nbWorkers).upperBound)
+	{
+		H5Epush2(H5E_DEFAULT, __FILE__, "zstd_can_apply", __LINE__, H5E_ERR_CLS, H5E_PLINE, H5E_CANTINIT,
+			"Unsupported number of Zstd workers: zstd is not multithreaded or the number is too large");
+		return -1;
+	}
+	if (cd_nelmts > 4 && cd_values[4] > 0 &&
+		((int)cd_values[4] < ZSTD_cParam_getBounds(ZSTD_c_windowLog).lowerBound ||
+		(int)cd_values[4] > ZSTD_cParam_getBounds(ZSTD_c_windowLog).upperBound))
+	{
+		H5Epush2(H5E_DEFAULT, __FILE__, "zstd_can_apply", __LINE__, H5E_ERR_CLS, H5E_PLINE, H5E_CANTINIT,
+			"Unsupported Zstd window log on this platform");
+		return -1;
+	}
+	return 1;
+}
+
 DLL_EXPORT size_t zstd_filter(unsigned int flags, size_t cd_nelmts,
 	const unsigned int cd_values[], size_t nbytes,
 	size_t *buf_size, void **buf)
@@ -17,14 +66,33 @@ DLL_EXPORT size_t zstd_filter(unsigned int flags, size_t cd_nelmts,
 
 	if (flags & H5Z_FLAG_REVERSE)
 	{
-		size_t decompSize = ZSTD_getDecompressedSize(*buf, origSize);
+		unsigned long long frameSize = ZSTD_getFrameContentSize(*buf, origSize);
+		if (frameSize == ZSTD_CONTENTSIZE_UNKNOWN || frameSize == ZSTD_CONTENTSIZE_ERROR || frameSize > SIZE_MAX)
+			goto error;
+		size_t decompSize = (size_t)frameSize;
 		if (NULL == (outbuf = malloc(decompSize)))
 			goto error;
 
-		decompSize = ZSTD_decompress(outbuf, decompSize, inbuf, origSize);
+		if (zstd_dctx == NULL)
+		{
+			if (NULL == (zstd_dctx = ZSTD_createDCtx()))
+				goto error;
+			/* Accept windows above the default limit (27), see the window_log option */
+			ZSTD_DCtx_setParameter(zstd_dctx, ZSTD_d_windowLogMax,
+				ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound);
+		}
+		decompSize = ZSTD_decompressDCtx(zstd_dctx, outbuf, decompSize, inbuf, origSize);
+		if (ZSTD_sizeof_DCtx(zstd_dctx) > ZSTD_CTX_KEEP_MAX_SIZE)
+		{
+			ZSTD_freeDCtx(zstd_dctx);
+			zstd_dctx = NULL;
+		}
+		if (ZSTD_isError(decompSize))
+			goto error;
 
 		free(*buf);
 		*buf = outbuf;
+		*buf_size = decompSize;
 		outbuf = NULL;
 		ret_value = (size_t)decompSize;
 	}
@@ -44,7 +112,36 @@ DLL_EXPORT size_t zstd_filter(unsigned int flags, size_t cd_nelmts,
 		if (NULL == (outbuf = malloc(compSize)))
 			goto error;
 
-		compSize = ZSTD_compress(outbuf, compSize, inbuf, origSize, aggression);
+		if (zstd_cctx == NULL && NULL == (zstd_cctx = ZSTD_createCCtx()))
+			goto error;
+		/* Parameters are kept in the context: set them for this dataset */
+		ZSTD_CCtx_reset(zstd_cctx, ZSTD_reset_session_and_parameters);
+		if (ZSTD_isError(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_compressionLevel, aggression)))
+			goto error;
+		/* Worker threads need a multithreaded zstd, see zstd_can_apply */
+		if (cd_nelmts > 1 && cd_values[1] > 0)
+		{
+			if (ZSTD_isError(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_nbWorkers, (int)cd_values[1])))
+				goto error;
+			if (cd_nelmts > 2 && cd_values[2] > 0 &&
+				ZSTD_isError(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_jobSize, (int)cd_values[2])))
+				goto error;
+		}
+		if (cd_nelmts > 3 && cd_values[3] > 0 &&
+			ZSTD_isError(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_enableLongDistanceMatching, 1)))
+			goto error;
+		if (cd_nelmts > 4 && cd_values[4] > 0 &&
+			ZSTD_isError(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_windowLog, (int)cd_values[4])))
+			goto error;
+		compSize = ZSTD_compress2(zstd_cctx, outbuf, compSize, inbuf, origSize);
+		/* Do not keep large workspaces around */
+		if (ZSTD_sizeof_CCtx(zstd_cctx) > ZSTD_CTX_KEEP_MAX_SIZE)
+		{
+			ZSTD_freeCCtx(zstd_cctx);
+			zstd_cctx = NULL;
+		}
+		if (ZSTD_isError(compSize))
+			goto error;
 
 		free(*buf);
 		*buf = outbuf;
@@ -57,6 +154,8 @@ DLL_EXPORT size_t zstd_filter(unsigned int flags, size_t cd_nelmts,
 	return ret_value;
 
 error:
+	if (outbuf != NULL)
+		free(outbuf);
 	return 0;
 }
 
@@ -66,7 +165,7 @@ const H5Z_class_t zstd_H5Filter =
 	(H5Z_filter_t)(ZSTD_FILTER),
 	1, 1,
 	"Zstandard compression: http://www.zstd.net",
-	NULL, NULL,
+	(H5Z_can_apply_func_t)(zstd_can_apply), NULL,
 	(H5Z_func_t)(zstd_filter)
 };
 
@@ -5,6 +5,7 @@
  */
 
 #include <sys/types.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -16,6 +17,7 @@
 #endif
 #include <H5PLextern.h>
 #include <lz4.h>
+#include <lz4hc.h>
 #include "lz4_h5filter.h"
 
 #define PUSH_ERR(func, minor, str)                                      \
@@ -38,7 +40,14 @@ static size_t H5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
 #define be64toht(x) ntohll(x)
 
 
-#define DEFAULT_BLOCK_SIZE 1<<30; /* 1GB. LZ4 needs blocks < 1.9GB. */
+#if defined(_OPENMP) && defined(_MSC_VER)
+typedef int64_t omp_size_t; /* MSVC only supports signed OpenMP loop indices */
+#else
+typedef size_t omp_size_t;
+#endif
+
+#define DEFAULT_BLOCK_SIZE (1<<20) /* 1MB, small enough to share a chunk between threads. */
+#define MAX_ACCELERATION 65537 /* LZ4_ACCELERATION_MAX of lz4.c, larger values are equivalent. */
 
 const H5Z_class2_t H5Z_LZ4[1] = {{
         H5Z_CLASS_T_VERS,       /* H5Z_class_t version */
@@ -57,17 +66,30 @@ static size_t H5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
         size_t *buf_size, void **buf)
 {
     void * outBuf = NULL;
+    size_t * offsets = NULL;     /* offsets of the compressed blocks */
+    uint32_t * compSizes = NULL; /* sizes of the compressed blocks */
     size_t ret_value;
+    int failed = 0;
+    omp_size_t block;
 
     if (flags & H5Z_FLAG_REVERSE)
     {
         uint32_t *i32Buf;
         uint32_t blockSize;
-        char *roBuf;   /* pointer to current write position */
-        uint64_t decompSize;
+        size_t nBlocks;
+        size_t offset;
         const char* rpos = (char*)*buf; /* pointer to current read position */
-        const uint64_t * const i64Buf = (uint64_t *) rpos;
-        const uint64_t origSize = (uint64_t)(be64toht(*i64Buf));/* is saved in be format */
+        const uint64_t * i64Buf;
+        uint64_t origSize;
+
+        /* Check the header before trusting it */
+        if(nbytes < 12)
+        {
+            PUSH_ERR("H5Z_filter_lz4", H5E_CALLBACK, "Compressed chunk is too small");
+            goto error;
+        }
+        i64Buf = (uint64_t *) rpos;
+        origSize = (uint64_t)(be64toht(*i64Buf));/* is saved in be format */
         rpos += 8; /* advance the pointer */
 
         i32Buf = (uint32_t*)rpos;
@@ -75,69 +97,95 @@ static size_t H5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
         rpos += 4;
         if(blockSize>origSize)
             blockSize = origSize;
+        /* Each block has a 4 bytes header and LZ4 expands data at most 255 times */
+        if((blockSize == 0 && origSize > 0) || blockSize > LZ4_MAX_INPUT_SIZE ||
+                origSize > SIZE_MAX || origSize / 255 > nbytes ||
+                (origSize > 0 && ((origSize-1)/blockSize +1) > (nbytes-12)/4))
+        {
+            PUSH_ERR("H5Z_filter_lz4", H5E_CALLBACK, "Invalid chunk header");
+            goto error;
+        }
+
+        /* Find the offsets of the blocks from their headers */
+        nBlocks = (origSize == 0) ? 0 : (origSize-1)/blockSize +1;
+        if (NULL == (offsets = (size_t *) malloc((nBlocks + 1) * sizeof(size_t))))
+            goto error;
+        offset = 12;
+        for(block = 0; block < (omp_size_t) nBlocks; ++block)
+        {
+            uint32_t compressedBlockSize;
+            if(nbytes - offset < 4)
+                break;
+            i32Buf = (uint32_t*)((char*)*buf + offset);
+            compressedBlockSize = be32toht(*i32Buf);  /// is saved in be format
+            if(compressedBlockSize > blockSize || compressedBlockSize > nbytes - offset - 4)
+                break;
+            offsets[block] = offset;
+            offset += 4 + (size_t) compressedBlockSize;
+        }
+        if((size_t) block != nBlocks)
+        {
+            PUSH_ERR("H5Z_filter_lz4", H5E_CALLBACK, "Compressed block exceeds chunk");
+            goto error;
+        }
 
         if (NULL==(outBuf = H5allocate_memory(origSize, false)))
         {
             printf("error calling H5allocate_memory\n");
             goto error;
         }
-        roBuf = (char*)outBuf;   /* pointer to current write position */
-        decompSize     = 0;
-        /// start with the first block ///
-        while(decompSize < origSize)
+
+        /* Decompress the independent blocks in parallel */
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic, 1) if (nBlocks > 1) reduction(|:failed)
+#endif
+        for(block = 0; block < (omp_size_t) nBlocks; ++block)
         {
-            uint32_t compressedBlockSize;  /// is saved in be format
+            const char* blockBuf = (char*)*buf + offsets[block];
+            char* roBuf = (char*)outBuf + (size_t) block*blockSize; /* write position */
+            uint32_t origBlockSize = blockSize;
+            uint32_t compressedBlockSize =  be32toht(*(uint32_t*)blockBuf);  /// is saved in be format
 
-            if(origSize-decompSize < blockSize) /* the last block can be smaller than blockSize. */
-                blockSize = origSize-decompSize;
-            i32Buf = (uint32_t*)rpos;
-            compressedBlockSize =  be32toht(*i32Buf);  /// is saved in be format
-            rpos += 4;
-            if(compressedBlockSize == blockSize) /* there was no compression */
+            if(origSize - (size_t) block*blockSize < blockSize) /* the last block can be smaller than blockSize. */
+                origBlockSize = origSize - (size_t) block*blockSize;
+            if(compressedBlockSize == origBlockSize) /* there was no compression */
             {
-                memcpy(roBuf, rpos, blockSize);
+                memcpy(roBuf, blockBuf + 4, origBlockSize);
             }
-            else /* do the decompression */
+            else /* do the decompression, checking bounds of both buffers */
             {
-#if LZ4_VERSION_NUMBER > 10300
-                int compressedBytes = LZ4_decompress_fast(rpos, roBuf, blockSize);
-#else
-                int compressedBytes = LZ4_uncompress(rpos, roBuf, blockSize);
-#endif
-                if(compressedBytes != compressedBlockSize)
-                {
-                    printf("decompressed size not the same: %d, != %d\n", compressedBytes, compressedBlockSize);
-                    goto error;
-                }
+                int decompressedBytes = LZ4_decompress_safe(
+                    blockBuf + 4, roBuf, (int) compressedBlockSize, (int) origBlockSize);
+                if(decompressedBytes != (int) origBlockSize)
+                    failed = 1;
             }
-
-            rpos += compressedBlockSize;   /* advance the read pointer to the next block */
-            roBuf += blockSize;            /* advance the write pointer */
-            decompSize += blockSize;
         }
+        if(failed)
+        {
+            PUSH_ERR("H5Z_filter_lz4", H5E_CALLBACK, "Decompressed block size mismatch");
+            goto error;
+        }
+
+        free(offsets);
         H5free_memory(*buf);
         *buf = outBuf;
         outBuf = NULL;
-        ret_value = (size_t)origSize;  // should always work, as orig_size cannot be > 2GB (sizeof(size_t) < 4GB)
+        ret_value = (size_t)origSize;  // origSize <= SIZE_MAX was checked with the header
     }
     else /* forward filter */
     {
         size_t blockSize;
         size_t nBlocks;
         size_t outSize; /* size of the output buffer. Header size (12 bytes) is included */
-        size_t block;
+        size_t slotSize; /* size reserved for each compressed block and its size */
         uint64_t *i64Buf;
         uint32_t *i32Buf;
         size_t maxDestSize;
-        char *rpos;      /* pointer to current read position */
         char *roBuf;    /* pointer to current write position */
+        /* positive for LZ4HC, negative for LZ4 acceleration */
+        int level = (cd_nelmts > 2) ? (int) cd_values[2] : 0;
 
-        if (nbytes > INT32_MAX)
-        {
-            /* can only compress chunks up to 2GB */
-            goto error;
-        }
-
+        /* Chunks can be larger than 2GB, but each block must fit in LZ4 limits */
         if(cd_nelmts > 0 && cd_values[0] > 0)
         {
             blockSize = cd_values[0];
@@ -146,19 +194,32 @@ static size_t H5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
         {
             blockSize = DEFAULT_BLOCK_SIZE;
         }
+        if(blockSize > LZ4_MAX_INPUT_SIZE)
+        {
+            blockSize = LZ4_MAX_INPUT_SIZE;
+        }
         if(blockSize > nbytes)
         {
             blockSize = nbytes;
         }
+        /* Bound the acceleration, so that it can be negated */
+        if(level < -MAX_ACCELERATION)
+        {
+            level = -MAX_ACCELERATION;
+        }
         nBlocks = (nbytes-1)/blockSize +1;
-        maxDestSize = nBlocks * LZ4_compressBound(blockSize) + 4 + 8 + nBlocks*4;
+        slotSize = LZ4_compressBound(blockSize) + 4;
+        maxDestSize = nBlocks * slotSize + 8 + 4;
         outBuf = H5allocate_memory(maxDestSize, false);
         if (NULL == outBuf)
         {
             goto error;
         }
+        if (NULL == (compSizes = (uint32_t *) malloc(nBlocks * sizeof(uint32_t))))
+        {
+            goto error;
+        }
 
-        rpos  = (char*)*buf;      /* pointer to current read position */
         roBuf = (char*)outBuf;    /* pointer to current write position */
         /* header */
         i64Buf = (uint64_t *) (roBuf);
@@ -169,37 +230,52 @@ static size_t H5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
         i32Buf[0] = htobe32t((uint32_t)blockSize); /* Store the block size in be format */
         roBuf += 4;
 
-        outSize = 12; /* size of the output buffer. Header size (12 bytes) is included */
-
-        for(block = 0; block < nBlocks; ++block)
+        /* Compress the blocks in parallel, each one to its own slot */
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic, 1) if (nBlocks > 1) reduction(|:failed)
+#endif
+        for(block = 0; block < (omp_size_t) nBlocks; ++block)
         {
-            uint32_t compBlockSize; /// reserve space for compBlockSize
-            size_t origWritten = block*blockSize;
-            if(nbytes - origWritten < blockSize) /* the last block may be < blockSize */
-                blockSize = nbytes - origWritten;
+            const char *rpos = (char*)*buf + (size_t) block*blockSize; /* read position */
+            char *slot = roBuf + (size_t) block*slotSize; /* write position */
+            size_t origBlockSize = blockSize;
+            uint32_t compBlockSize;
+            if(nbytes - (size_t) block*blockSize < blockSize) /* the last block may be < blockSize */
+                origBlockSize = nbytes - (size_t) block*blockSize;
 
 #if LZ4_VERSION_NUMBER > 10300
-            compBlockSize = LZ4_compress_default(rpos, roBuf+4, blockSize, LZ4_compressBound(blockSize)); /// reserve space for compBlockSize
+            if(level > 0)
+                compBlockSize = LZ4_compress_HC(rpos, slot+4, origBlockSize, LZ4_compressBound(origBlockSize), level);
+            else if(level < 0)
+                compBlockSize = LZ4_compress_fast(rpos, slot+4, origBlockSize, LZ4_compressBound(origBlockSize), -level);
+            else
+                compBlockSize = LZ4_compress_default(rpos, slot+4, origBlockSize, LZ4_compressBound(origBlockSize)); /// reserve space for compBlockSize
 #else
-            compBlockSize = LZ4_compress(rpos, roBuf+4, blockSize); /// reserve space for compBlockSize
+            compBlockSize = LZ4_compress(rpos, slot+4, origBlockSize); /// reserve space for compBlockSize
 #endif
             if(!compBlockSize)
-                goto error;
-            if(compBlockSize >= blockSize) /* compression did not save any space, do a memcpy instead */
+                failed = 1;
+            if(compBlockSize >= origBlockSize) /* compression did not save any space, do a memcpy instead */
             {
-                compBlockSize = blockSize;
-                memcpy(roBuf+4, rpos, blockSize);
+                compBlockSize = origBlockSize;
+                memcpy(slot+4, rpos, origBlockSize);
             }
 
-            i32Buf =  (uint32_t *) (roBuf);
-            i32Buf[0] = htobe32t((uint32_t)compBlockSize);  /* write blocksize */
-            roBuf += 4;
+            *(uint32_t *) slot = htobe32t((uint32_t)compBlockSize);  /* write blocksize */
+            compSizes[block] = compBlockSize;
+        }
+        if(failed)
+            goto error;
 
-            rpos += blockSize;     	/* advance read pointer */
-            roBuf += compBlockSize;       /* advance write pointer */
-            outSize += compBlockSize + 4;
+        /* Move the blocks next to each other */
+        outSize = 12; /* size of the output buffer. Header size (12 bytes) is included */
+        for(block = 0; block < (omp_size_t) nBlocks; ++block)
+        {
+            memmove((char*)outBuf + outSize, roBuf + (size_t) block*slotSize, compSizes[block] + 4);
+            outSize += compSizes[block] + 4;
         }
 
+        free(compSizes);
         H5free_memory(*buf);
         *buf = outBuf;
         *buf_size = outSize;
@@ -214,6 +290,8 @@ static size_t H5Z_filter_lz4(unsigned int flags, size_t cd_nelmts,
 
 
     error:
+    free(offsets);
+    free(compSizes);
     if(outBuf)
         H5free_memory(outBuf);
     outBuf = NULL;
@@ -7,8 +7,14 @@
  * --------------
  *  block_size (option slot 0) : interger (optional)
  *      What block size to use. Default is 0,
- *      for which lz4 will pick a block size.
+ *      for which lz4 will pick a block size (1 MiB).
+ *      Blocks are limited to LZ4_MAX_INPUT_SIZE, while chunks can be larger.
  *  number_of_threads (option slot 1) : Not currently implemented
+ *  compression_level (option slot 2) : integer (optional)
+ *      0 (default) for LZ4 default compression, 1 to 12 for LZ4HC
+ *      compression at that level, negative for faster LZ4 compression with
+ *      an acceleration factor of minus the value, stored as a 32 bit two's
+ *      complement integer. Blocks are plain LZ4 blocks whatever the level.
  *
  *      The compressed format of the data is described in
  *      http://www.hdfgroup.org/services/filters/HDF5_LZ4.pdf.
@@ -16,6 +16,14 @@
 #include "hdf5.h"
 #include "blosc2_filter.h"
 #include "b2nd.h"
+#include "blosc2/codecs-registry.h"
+#include "blosc2/filters-registry.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 #if defined(__GNUC__)
 #define PUSH_ERR(func, minor, str, ...) H5Epush(H5E_DEFAULT, __FILE__, func, __LINE__, H5E_ERR_CLS, H5E_PLINE, minor, str, ##__VA_ARGS__)
@@ -38,14 +46,37 @@
  * - 4: compression level
  * - 5: shuffle method
  * - 6: compressor code
- * - 7: chunk rank (number of dimensions) (present if 1 < rank <= BLOSC2_MAX_DIM, for B2ND)
+ * - 7: chunk rank (number of dimensions) (present if 1 < rank <= BLOSC2_MAX_DIM, for B2ND,
+ *      or 0 if extended values follow and B2ND is not used)
  * - 8 + i: length of chunk dimension i (0 <= i < rank)
  *
+ * Extended values start at a fixed slot (EXT_FILTER_VALUES, unused chunk
+ * dimension slots are zeroed) and are:
+ *
+ * - 16: reserved, 0 (the number of threads is the process-wide default)
+ * - 17: storage format (STORAGE_FRAME or STORAGE_RAW_CHUNK)
+ * - 18 + i: filter i of the pipeline (0 <= i < BLOSC2_MAX_FILTERS),
+ *   with its code in the low byte and its meta in the next one
+ *   (if present, the pipeline replaces the shuffle method, missing filters are 0)
+ * - 24: compressor meta (e.g. cell size for NDLZ, tolerance/precision/rate for ZFP codecs)
+ * - 25: expected access pattern to tune B2ND block shape
+ *   (0 for default, 1 + axis for slices at given indices along that axis)
+ *
  * If a value is specified, all values before it must be specified too.
  *
  * If the chunk rank is specified, chunk dimensions must follow.
  */
-#define MAX_FILTER_VALUES (8 + BLOSC2_MAX_DIM)
+#if BLOSC2_MAX_DIM > 8
+#error "Chunk dimension slots overlap extended filter values"
+#endif
+#define EXT_FILTER_VALUES 16
+#define PIPELINE_FILTER_VALUES (EXT_FILTER_VALUES + 2)
+#define COMPCODE_META_FILTER_VALUE (PIPELINE_FILTER_VALUES + BLOSC2_MAX_FILTERS)
+#define ACCESS_FILTER_VALUE (COMPCODE_META_FILTER_VALUE + 1)
+#define MAX_FILTER_VALUES (ACCESS_FILTER_VALUE + 1)
+/* Storage formats */
+#define STORAGE_FRAME 0      /* Contiguous super-chunk frame, with B2ND metalayers if applicable */
+#define STORAGE_RAW_CHUNK 1  /* Bare Blosc2 chunk, without B2ND support */
 /* Compression level default */
 #define DEFAULT_CLEVEL 5
 /* Shuffle default */
@@ -61,6 +92,145 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
 herr_t blosc2_set_local(hid_t dcpl, hid_t type, hid_t space);
 
 
+/* Pool of Blosc2 contexts reused across filter calls.
+ *
+ * Creating a context (and starting its threads) for each chunk is costly,
+ * so contexts are taken from the pool for the duration of a filter call
+ * and given back afterwards.  A context is only used by one call at a time.
+ * Compression contexts are looked up by their compression parameters,
+ * decompression contexts by their number of threads.
+ *
+ * The pool is shared by all threads rather than kept in thread-local storage:
+ * contexts of exited HDF5 application threads would otherwise leak with their
+ * threads.  Its lock is only held to look up and store contexts, not while
+ * compressing, so threads hardly contend on it.
+ */
+#define CTX_POOL_SIZE 16
+
+typedef struct {
+  blosc2_context *ctx;
+  int compress;            /* Whether this is a compression context */
+  blosc2_cparams cparams;  /* Only nthreads is relevant for decompression */
+} pooled_ctx_t;
+
+static pooled_ctx_t ctx_pool[CTX_POOL_SIZE];
+static int ctx_pool_len = 0;
+
+#if defined(_WIN32)
+static SRWLOCK ctx_pool_lock = SRWLOCK_INIT;
+#define LOCK_CTX_POOL() AcquireSRWLockExclusive(&ctx_pool_lock)
+#define UNLOCK_CTX_POOL() ReleaseSRWLockExclusive(&ctx_pool_lock)
+#else
+static pthread_mutex_t ctx_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CTX_POOL() pthread_mutex_lock(&ctx_pool_lock)
+#define UNLOCK_CTX_POOL() pthread_mutex_unlock(&ctx_pool_lock)
+#endif
+
+/* Pooled contexts are not attached to a super-chunk, which is only
+ * supported by the codecs and filters built in the Blosc2 library
+ * (plugins may need the super-chunk metalayers). */
+static int is_ctx_poolable(int compcode, const uint8_t *filters) {
+  if (compcode >= BLOSC_LAST_CODEC) {
+    return 0;
+  }
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (filters[i] >= BLOSC_LAST_FILTER) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int is_same_pooled_ctx(const pooled_ctx_t *pooled, int compress,
+                              const blosc2_cparams *cparams) {
+  const blosc2_cparams *ref = &pooled->cparams;
+
+  if (pooled->compress != compress || ref->nthreads != cparams->nthreads) {
+    return 0;
+  }
+  if (!compress) {
+    return 1;
+  }
+  if (ref->compcode != cparams->compcode
+      || ref->compcode_meta != cparams->compcode_meta
+      || ref->clevel != cparams->clevel
+      || ref->typesize != cparams->typesize
+      || ref->blocksize != cparams->blocksize
+      || ref->splitmode != cparams->splitmode) {
+    return 0;
+  }
+  return (memcmp(ref->filters, cparams->filters, BLOSC2_MAX_FILTERS) == 0
+          && memcmp(ref->filters_meta, cparams->filters_meta, BLOSC2_MAX_FILTERS) == 0);
+}
+
+/* Take a context matching the given parameters from the pool or create one.
+ * Only the number of threads of cparams is used for decompression. */
+static blosc2_context *acquire_ctx(int compress, const blosc2_cparams *cparams) {
+  blosc2_context *ctx = NULL;
+
+  LOCK_CTX_POOL();
+  for (int i = ctx_pool_len - 1; i >= 0; i--) {
+    if (is_same_pooled_ctx(&ctx_pool[i], compress, cparams)) {
+      ctx = ctx_pool[i].ctx;
+      memmove(&ctx_pool[i], &ctx_pool[i + 1], (ctx_pool_len - i - 1) * sizeof(pooled_ctx_t));
+      ctx_pool_len--;
+      break;
+    }
+  }
+  UNLOCK_CTX_POOL();
+
+  if (ctx == NULL) {
+    if (compress) {
+      blosc2_cparams ctx_cparams = *cparams;
+      ctx_cparams.schunk = NULL;
+      ctx = blosc2_create_cctx(ctx_cparams);
+    } else {
+      blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+      dparams.nthreads = cparams->nthreads;
+      ctx = blosc2_create_dctx(dparams);
+    }
+  }
+  return ctx;
+}
+
+/* Give a context back to the pool, discarding the least recently used one if full. */
+static void release_ctx(blosc2_context *ctx, int compress, const blosc2_cparams *cparams) {
+  blosc2_context *discarded = NULL;
+
+  if (ctx == NULL) {
+    return;
+  }
+
+  LOCK_CTX_POOL();
+  if (ctx_pool_len == CTX_POOL_SIZE) {
+    discarded = ctx_pool[0].ctx;
+    memmove(&ctx_pool[0], &ctx_pool[1], (CTX_POOL_SIZE - 1) * sizeof(pooled_ctx_t));
+    ctx_pool_len--;
+  }
+  ctx_pool[ctx_pool_len].ctx = ctx;
+  ctx_pool[ctx_pool_len].compress = compress;
+  ctx_pool[ctx_pool_len].cparams = *cparams;
+  ctx_pool_len++;
+  UNLOCK_CTX_POOL();
+
+  if (discarded != NULL) {
+    blosc2_free_ctx(discarded);
+  }
+}
+
+void release_blosc2_contexts(void) {
+  LOCK_CTX_POOL();
+  for (int i = 0; i < ctx_pool_len; i++) {
+    blosc2_free_ctx(ctx_pool[i].ctx);
+    ctx_pool[i].ctx = NULL;
+  }
+  ctx_pool_len = 0;
+  UNLOCK_CTX_POOL();
+
+  blosc2_destroy();
+}
+
+
 /* Register the filter, passing on the HDF5 return value */
 int register_blosc2(char **version, char **date){
 
@@ -96,6 +266,8 @@ int register_blosc2(char **version, char **date){
     3. Compute the chunk size in bytes and store it in slot 3.
 
     4. If 1 < rank <= BLOSC2_MAX_DIM, store it in slot 7, and chunk dimensions in the following slots.
+
+    5. Keep extended values (from slot EXT_FILTER_VALUES) if any.
 */
 herr_t blosc2_set_local(hid_t dcpl, hid_t type, hid_t space) {
 
@@ -118,6 +290,8 @@ herr_t blosc2_set_local(hid_t dcpl, hid_t type, hid_t space) {
 
   if (nelements < 4)
     nelements = 4;  /* First 4 slots reserved. */
+  if (nelements > MAX_FILTER_VALUES)
+    nelements = MAX_FILTER_VALUES;  /* Ignore unknown values. */
 
   /* Set Blosc2 info in first slot */
   values[0] = FILTER_BLOSC2_VERSION;
@@ -157,17 +331,29 @@ herr_t blosc2_set_local(hid_t dcpl, hid_t type, hid_t space) {
   fprintf(stderr, "Blosc2: Computed buffer size %d\n", bufsize);
 #endif
 
-  if (1 < ndim && ndim <= BLOSC2_MAX_DIM) {
+  int has_ext_values = nelements > EXT_FILTER_VALUES;
+  int use_b2nd = 1 < ndim && ndim <= BLOSC2_MAX_DIM;
+
+  if (use_b2nd || has_ext_values) {
     if (nelements < 5) { values[4] = DEFAULT_CLEVEL; }
     if (nelements < 6) { values[5] = DEFAULT_SHUFFLE; }
     if (nelements < 7) { values[6] = DEFAULT_COMPCODE; }
 
+    /* Chunk rank and dimensions, zeroed when unused */
+    for (i = 7; i < EXT_FILTER_VALUES; i++) {
+      values[i] = 0;
+    }
+  }
+
+  if (use_b2nd) {
     values[7] = ndim;
     for (int i = 0; i < ndim; i++) {
       values[8 + i] = (unsigned int)(chunkshape[i]);
     };
 
-    nelements = 8 + ndim;
+    if (!has_ext_values) {
+      nelements = 8 + ndim;
+    }
   } else if (ndim > 1) {
     /* The user may be expecting more efficient storage than we can currently provide,
      * so convey some information when tracing. */
@@ -175,6 +361,30 @@ herr_t blosc2_set_local(hid_t dcpl, hid_t type, hid_t space) {
                         "using plain Blosc2 instead", ndim, BLOSC2_MAX_DIM);
   }
 
+  /* Raw chunks have no B2ND metalayers, reject what needs them */
+  if (nelements > EXT_FILTER_VALUES + 1 && values[EXT_FILTER_VALUES + 1] == STORAGE_RAW_CHUNK) {
+    if (values[6] == BLOSC_CODEC_NDLZ || values[6] == BLOSC_CODEC_ZFP_FIXED_ACCURACY ||
+        values[6] == BLOSC_CODEC_ZFP_FIXED_PRECISION || values[6] == BLOSC_CODEC_ZFP_FIXED_RATE) {
+      PUSH_ERR("blosc2_set_local", H5E_CALLBACK,
+               "Compressor code %u is not supported with raw chunks", values[6]);
+      return -1;
+    }
+    for (i = PIPELINE_FILTER_VALUES;
+         i < PIPELINE_FILTER_VALUES + BLOSC2_MAX_FILTERS && i < (int) nelements; i++) {
+      unsigned int code = values[i] & 0xff;
+      if (code == BLOSC_FILTER_NDCELL || code == BLOSC_FILTER_NDMEAN) {
+        PUSH_ERR("blosc2_set_local", H5E_CALLBACK,
+                 "Filter code %u is not supported with raw chunks", code);
+        return -1;
+      }
+    }
+    if (nelements > ACCESS_FILTER_VALUE && values[ACCESS_FILTER_VALUE] != 0) {
+      PUSH_ERR("blosc2_set_local", H5E_CALLBACK,
+               "Access pattern is not supported with raw chunks");
+      return -1;
+    }
+  }
+
   r = H5Pmodify_filter(dcpl, FILTER_BLOSC2, flags, nelements, values);
   if (r < 0)
     return -1;
@@ -206,6 +416,84 @@ int32_t compute_blosc2_blocksize(int32_t chunksize, int32_t typesize,
 }
 
 
+int64_t decompress_b2nd_chunk_slice(const void *cbuffer, size_t cbytes, int ndim,
+                                    const int64_t *start, const int64_t *stop,
+                                    void *buffer, size_t buffer_size) {
+  int64_t status = -1;
+  b2nd_array_t *array = NULL;
+
+  if (ndim < 1 || ndim > BLOSC2_MAX_DIM) {
+    BLOSC_TRACE_ERROR("Unsupported rank %d for B2ND", ndim);
+    return -1;
+  }
+
+  blosc2_init();
+
+  blosc2_schunk *schunk = blosc2_schunk_from_buffer((uint8_t *)cbuffer, (int64_t)cbytes, false);
+  if (schunk == NULL) {
+    BLOSC_TRACE_ERROR("Cannot get super-chunk from buffer");
+    return -1;
+  }
+  if (blosc2_meta_exists(schunk, "b2nd") < 0
+      && blosc2_meta_exists(schunk, "caterva") < 0) {
+    BLOSC_TRACE_ERROR("Super-chunk is not a B2ND array");
+    blosc2_schunk_free(schunk);
+    return -1;
+  }
+
+  /* Decompress with a pooled context if possible */
+  blosc2_schunk *dctx_schunk = schunk;
+  blosc2_context *schunk_dctx = schunk->dctx;
+  blosc2_context *pooled_dctx = NULL;
+  blosc2_cparams dctx_params = BLOSC2_CPARAMS_DEFAULTS;
+  dctx_params.nthreads = blosc2_get_nthreads();
+  if (is_ctx_poolable(schunk->compcode, schunk->filters)) {
+    pooled_dctx = acquire_ctx(0, &dctx_params);
+  }
+  if (pooled_dctx != NULL) {
+    schunk->dctx = pooled_dctx;
+  }
+
+  if (b2nd_from_schunk(schunk, &array) < 0) {
+    BLOSC_TRACE_ERROR("Cannot create B2ND array from super-chunk");
+    goto out;
+  }
+  schunk = NULL;  // owned by the array now, do not free on its own
+
+  if (array->ndim != ndim) {
+    BLOSC_TRACE_ERROR("B2ND array rank (%d) != requested rank (%d)", array->ndim, ndim);
+    goto out;
+  }
+  int64_t buffershape[BLOSC2_MAX_DIM], size = array->sc->typesize;
+  for (int i = 0; i < ndim; i++) {
+    if (start[i] < 0 || start[i] > stop[i] || stop[i] > array->shape[i]) {
+      BLOSC_TRACE_ERROR("Hyperslab [%lld, %lld) out of B2ND array shape[%d] (%lld)",
+                        (long long)start[i], (long long)stop[i], i, (long long)array->shape[i]);
+      goto out;
+    }
+    buffershape[i] = stop[i] - start[i];
+    size *= buffershape[i];
+  }
+  if ((size_t)size > buffer_size) {
+    BLOSC_TRACE_ERROR("Buffer too small for hyperslab (%zu < %lld)", buffer_size, (long long)size);
+    goto out;
+  }
+  if (size > 0
+      && b2nd_get_slice_cbuffer(array, start, stop, buffer, buffershape, size) < 0) {
+    BLOSC_TRACE_ERROR("Cannot decompress B2ND array hyperslab into buffer");
+    goto out;
+  }
+  status = size;
+
+  out:
+  dctx_schunk->dctx = schunk_dctx;
+  if (array) b2nd_free(array);
+  if (schunk) blosc2_schunk_free(schunk);
+  release_ctx(pooled_dctx, 0, &dctx_params);
+  return status;
+}
+
+
 /* Get the maximum block size which is not greater than the given block_size
  * and fits within the given chunk dimensions dims_chunk. Sizes must always be
  * greater than 0.
@@ -215,6 +503,10 @@ int32_t compute_blosc2_blocksize(int32_t chunksize, int32_t typesize,
  * the locality of C array arrangement.  The resulting block dimensions are
  * placed in the last (output) argument.
  *
+ * If thin_axis is a valid dimension index, the block dimension along that axis
+ * is kept to 1, so that reading a slice at a given index along that axis
+ * only needs to decompress the blocks of that slice.
+ *
  * Based on Python-Blosc2's blosc2.core.compute_chunks_blocks and
  * compute_partition.
  */
@@ -222,6 +514,7 @@ int32_t compute_b2nd_block_shape(size_t block_size,
                                  size_t type_size,
                                  const int rank,
                                  const int32_t *dims_chunk,
+                                 const int thin_axis,
                                  int32_t *dims_block) {
   assert(block_size >= 0);
   assert(type_size >= 0);
@@ -231,7 +524,7 @@ int32_t compute_b2nd_block_shape(size_t block_size,
   size_t nitems_new = 1;
   for (int i = 0; i < rank; i++) {
     assert(dims_chunk[i] != 0);
-    dims_block[i] = dims_chunk[i] == 1 ? 1 : 2;
+    dims_block[i] = (dims_chunk[i] == 1 || i == thin_axis) ? 1 : 2;
     nitems_new *= dims_block[i];
   }
 
@@ -248,7 +541,9 @@ int32_t compute_b2nd_block_shape(size_t block_size,
   while (nitems_new < nitems) {
     size_t nitems_prev = nitems_new;
     for (int i = rank - 1; i >= 0; i--) {
-      if (dims_block[i] * 2 <= dims_chunk[i]) {
+      if (i == thin_axis) {
+        continue;  // keep thin
+      } else if (dims_block[i] * 2 <= dims_chunk[i]) {
         if (nitems_new * 2 <= nitems) {
           nitems_new *= 2;
           dims_block[i] *= 2;
@@ -283,6 +578,8 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
   int clevel = DEFAULT_CLEVEL;
   int doshuffle = DEFAULT_SHUFFLE;
   int compcode = DEFAULT_COMPCODE;
+  int nthreads = 0;
+  int storage_format = STORAGE_FRAME;
 
   if (cd_nelmts < 4) {
     PUSH_ERR("blosc2_filter", H5E_CALLBACK,
@@ -299,7 +596,7 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
   int ndim = -1;
   int32_t chunkshape[BLOSC2_MAX_DIM];
   size_t chunksize = typesize;
-  if (cd_nelmts >= 8) {
+  if (cd_nelmts >= 8 && cd_values[7] != 0) {
     /* Get chunk shape for B2ND */
     ndim = cd_values[7];
     if (ndim < 2) {
@@ -326,6 +623,19 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
     }
   }
 
+  /* Process-wide number of threads, see blosc2_set_nthreads */
+  nthreads = blosc2_get_nthreads();
+
+  /* Extended filter params */
+  if (cd_nelmts > EXT_FILTER_VALUES + 1) {
+    storage_format = cd_values[EXT_FILTER_VALUES + 1];
+  }
+  if (storage_format != STORAGE_FRAME && storage_format != STORAGE_RAW_CHUNK) {
+    PUSH_ERR("blosc2_filter", H5E_CALLBACK,
+             "Unsupported storage format %d (filter value)", storage_format);
+    goto failed;
+  }
+
   blosc2_init();
 
   if (!(flags & H5Z_FLAG_REVERSE)) {
@@ -362,14 +672,41 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
 
     blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
     cparams.compcode = compcode;
+    if (cd_nelmts > COMPCODE_META_FILTER_VALUE) {
+      if (cd_values[COMPCODE_META_FILTER_VALUE] > UINT8_MAX) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Invalid compressor meta %u (filter value)",
+                 cd_values[COMPCODE_META_FILTER_VALUE]);
+        goto failed;
+      }
+      cparams.compcode_meta = (uint8_t) cd_values[COMPCODE_META_FILTER_VALUE];
+    }
     cparams.typesize = (int32_t) typesize;
-    cparams.filters[BLOSC_LAST_FILTER] = doshuffle;
+    if (cd_nelmts > PIPELINE_FILTER_VALUES) {
+      for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+        unsigned int value = 0;
+        if (cd_nelmts > (size_t)(PIPELINE_FILTER_VALUES + i)) {
+          value = cd_values[PIPELINE_FILTER_VALUES + i];
+        }
+        if (value > 0xffff) {
+          PUSH_ERR("blosc2_filter", H5E_CALLBACK,
+                   "Invalid pipeline filter %d (filter value %u)", i, value);
+          goto failed;
+        }
+        cparams.filters[i] = (uint8_t) (value & 0xff);
+        cparams.filters_meta[i] = (uint8_t) (value >> 8);
+      }
+    } else {
+      cparams.filters[BLOSC_LAST_FILTER] = doshuffle;
+    }
     cparams.clevel = clevel;
+    cparams.nthreads = (int16_t) nthreads;
     // cparams.blocksize depends on dimensionality
 
     blosc2_storage storage = {.cparams=&cparams, .contiguous=false};
 
-    if (ndim > 1 && nbytes != chunksize) {
+    if (storage_format == STORAGE_RAW_CHUNK) {
+      ndim = -1;  /* no B2ND metalayers to describe blocks */
+    } else if (ndim > 1 && nbytes != chunksize) {
       BLOSC_TRACE_INFO("Filter input size %lu does not match chunk data size %lu "
                        "(e.g. Fletcher32 checksum added before compression step), "
                        "using plain Blosc2 instead of B2ND",
@@ -377,7 +714,44 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
       ndim = -1;
     }
 
-    if (ndim > 1) {
+    if (storage_format == STORAGE_RAW_CHUNK) {
+      cparams.blocksize = blocksize;
+
+      if (nbytes > BLOSC2_MAX_BUFFERSIZE) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK,
+                 "Chunk of %zu bytes exceeds Blosc2 limit", nbytes);
+        goto failed;
+      }
+
+      /* Compress straight into the output buffer */
+      int pooled = is_ctx_poolable(compcode, cparams.filters);
+      blosc2_context *cctx = pooled ? acquire_ctx(1, &cparams) : blosc2_create_cctx(cparams);
+      if (cctx == NULL) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot create compression context");
+        goto failed;
+      }
+
+      outbuf_size = nbytes + BLOSC2_MAX_OVERHEAD;
+      outbuf = malloc(outbuf_size);
+      if (outbuf == NULL) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot allocate compression buffer");
+        goto raw_comp_out;
+      }
+
+      status = blosc2_compress_ctx(cctx, *buf, (int32_t) nbytes, outbuf, (int32_t) outbuf_size);
+      if (status <= 0) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot compress buffer");
+        goto raw_comp_out;
+      }
+
+      raw_comp_out:
+      if (pooled) {
+        release_ctx(cctx, 1, &cparams);
+      } else {
+        blosc2_free_ctx(cctx);
+      }
+
+    } else if (ndim > 1) {
 
       b2nd_context_t *ctx = NULL;
       b2nd_array_t *array = NULL;
@@ -391,9 +765,18 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
         }
         blocksize = sugg_blocksize;
       }
+      int thin_axis = -1;
+      if (cd_nelmts > ACCESS_FILTER_VALUE && cd_values[ACCESS_FILTER_VALUE] > 0) {
+        thin_axis = (int) cd_values[ACCESS_FILTER_VALUE] - 1;
+        if (thin_axis >= ndim) {
+          BLOSC_TRACE_WARNING("Access axis %d exceeds chunk rank %d, "
+                              "using default block shape", thin_axis, ndim);
+          thin_axis = -1;
+        }
+      }
       int32_t blockdims[BLOSC2_MAX_DIM];
       cparams.blocksize = compute_b2nd_block_shape(blocksize, typesize,
-                                                   ndim, chunkshape,
+                                                   ndim, chunkshape, thin_axis,
                                                    blockdims);
 
       int64_t chunkshape_l[BLOSC2_MAX_DIM];
@@ -410,7 +793,25 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
         goto b2nd_comp_out;
       }
 
-      if (b2nd_from_cbuffer(ctx, &array, *buf, nbytes) < 0) {
+      if (b2nd_empty(ctx, &array) < 0) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot create B2ND array");
+        goto b2nd_comp_out;
+      }
+
+      /* Compress with a pooled context if possible */
+      blosc2_context *array_cctx = array->sc->cctx;
+      blosc2_context *pooled_cctx = NULL;
+      if (is_ctx_poolable(compcode, cparams.filters)) {
+        pooled_cctx = acquire_ctx(1, &cparams);
+      }
+      if (pooled_cctx != NULL) {
+        array->sc->cctx = pooled_cctx;
+      }
+      int64_t start[BLOSC2_MAX_DIM] = {0};
+      int rc = b2nd_set_slice_cbuffer(*buf, array->shape, nbytes, start, array->shape, array);
+      array->sc->cctx = array_cctx;
+      release_ctx(pooled_cctx, 1, &cparams);
+      if (rc < 0) {
         PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot compress buffer into B2ND array");
         goto b2nd_comp_out;
       }
@@ -428,14 +829,39 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
     } else {
       cparams.blocksize = blocksize;
 
-      blosc2_context *cctx = blosc2_create_cctx(cparams);
+      uint8_t *chunk = NULL;
+      blosc2_context *cctx = NULL;
       blosc2_schunk* schunk = blosc2_schunk_new(&storage);
       if (schunk == NULL) {
         PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot create a super-chunk");
         goto b2_comp_out;
       }
 
-      status = blosc2_schunk_append_buffer(schunk, *buf, (int32_t) nbytes);
+      if (is_ctx_poolable(compcode, cparams.filters)) {
+        /* Compress with a pooled context and pass the chunk to the super-chunk */
+        cctx = acquire_ctx(1, &cparams);
+        if (cctx == NULL) {
+          PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot create compression context");
+          goto b2_comp_out;
+        }
+
+        int32_t chunk_size = (int32_t) nbytes + BLOSC2_MAX_OVERHEAD;
+        chunk = malloc(chunk_size);
+        if (chunk == NULL) {
+          PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot allocate compression buffer");
+          goto b2_comp_out;
+        }
+        status = blosc2_compress_ctx(cctx, *buf, (int32_t) nbytes, chunk, chunk_size);
+        if (status < 0) {
+          PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot compress buffer");
+          goto b2_comp_out;
+        }
+
+        status = blosc2_schunk_append_chunk(schunk, chunk, false);
+        chunk = NULL;  /* owned by the super-chunk now */
+      } else {
+        status = blosc2_schunk_append_buffer(schunk, *buf, (int32_t) nbytes);
+      }
       if (status < 0) {
         PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot append buffer to super-chunk");
         goto b2_comp_out;
@@ -450,7 +876,8 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
 
       b2_comp_out:
       if (schunk) blosc2_schunk_free(schunk);
-      if (cctx) blosc2_free_ctx(cctx);
+      if (chunk) free(chunk);
+      release_ctx(cctx, 1, &cparams);
 
     }
 
@@ -458,6 +885,46 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
     fprintf(stderr, "Blosc2: Compressed into %zd bytes\n", status);
 #endif
 
+  } else if (storage_format == STORAGE_RAW_CHUNK) {
+    /* We're decompressing a bare chunk */
+    int32_t chunk_nbytes, chunk_cbytes;
+
+    if (nbytes < BLOSC_MIN_HEADER_LENGTH
+        || blosc2_cbuffer_sizes(*buf, &chunk_nbytes, &chunk_cbytes, NULL) < 0
+        || chunk_cbytes < 0 || (size_t) chunk_cbytes > nbytes) {
+      PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Invalid Blosc2 chunk header");
+      goto failed;
+    }
+    outbuf_size = chunk_nbytes;
+
+#ifdef BLOSC2_DEBUG
+    fprintf(stderr, "Blosc2: Decompress %zd chunk w/buffer %zd\n", nbytes, outbuf_size);
+#endif
+
+    /* Default parameters are enough to read any chunk header */
+    blosc2_cparams dctx_params = BLOSC2_CPARAMS_DEFAULTS;
+    dctx_params.nthreads = (int16_t) nthreads;
+    blosc2_context *dctx = acquire_ctx(0, &dctx_params);
+    if (dctx == NULL) {
+      PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot create decompression context");
+      goto failed;
+    }
+
+    outbuf = malloc(outbuf_size);
+    if (outbuf == NULL) {
+      PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot allocate decompression buffer");
+      goto raw_decomp_out;
+    }
+
+    status = blosc2_decompress_ctx(dctx, *buf, chunk_cbytes, outbuf, (int32_t) outbuf_size);
+    if (status <= 0) {
+      PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot decompress chunk into buffer");
+      goto raw_decomp_out;
+    }
+
+    raw_decomp_out:
+    release_ctx(dctx, 0, &dctx_params);
+
   } else {
     /* We're decompressing */
     /* declare dummy variables */
@@ -478,6 +945,34 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
       goto failed;
     }
 
+    /* The super-chunk decompression context uses the number of threads
+     * stored in the frame, replace it to use the requested one,
+     * preferably with a pooled context. */
+    blosc2_schunk *dctx_schunk = schunk;
+    blosc2_context *schunk_dctx = schunk->dctx;
+    blosc2_context *pooled_dctx = NULL;
+    blosc2_cparams dctx_params = BLOSC2_CPARAMS_DEFAULTS;
+    dctx_params.nthreads = (int16_t) nthreads;
+
+    if (is_ctx_poolable(schunk->compcode, schunk->filters)) {
+      pooled_dctx = acquire_ctx(0, &dctx_params);
+    }
+    if (pooled_dctx != NULL) {
+      schunk->dctx = pooled_dctx;
+    } else {
+      blosc2_dparams schunk_dparams = BLOSC2_DPARAMS_DEFAULTS;
+      schunk_dparams.nthreads = (int16_t) nthreads;
+      schunk_dparams.schunk = schunk;
+      blosc2_context *dctx = blosc2_create_dctx(schunk_dparams);
+      if (dctx == NULL) {
+        PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot create decompression context");
+        blosc2_schunk_free(schunk);
+        goto failed;
+      }
+      blosc2_free_ctx(schunk_dctx);
+      schunk_dctx = schunk->dctx = dctx;
+    }
+
     /* Although blosc2_decompress_ctx ("else" branch) can decompress b2nd-formatted data,
      * there may be padding bytes when the chunkshape is not a multiple of the blockshape,
      * and only b2nd machinery knows how to handle these correctly.
@@ -538,14 +1033,14 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
       status = size;
 
       b2nd_decomp_out:
+      dctx_schunk->dctx = schunk_dctx;
       if (array) b2nd_free(array);
 
     } else {
 
-      uint8_t *chunk;
-      blosc2_context *dctx = NULL;
+      uint8_t *chunk = NULL;
 
-      bool needs_free;
+      bool needs_free = false;
       cbytes = blosc2_schunk_get_lazychunk(schunk, 0, &chunk, &needs_free);
       if (cbytes < 0) {
         PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot get chunk from super-chunk");
@@ -567,22 +1062,20 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
         goto b2_decomp_out;
       }
 
-      blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
-      dparams.schunk = schunk;
-      dctx = blosc2_create_dctx(dparams);
-      status = blosc2_decompress_ctx(dctx, chunk, cbytes, outbuf, (int32_t) outbuf_size);
+      status = blosc2_decompress_ctx(schunk->dctx, chunk, cbytes, outbuf, (int32_t) outbuf_size);
       if (status <= 0) {
         PUSH_ERR("blosc2_filter", H5E_CALLBACK, "Cannot decompress chunk into buffer");
         goto b2_decomp_out;
       }
 
       b2_decomp_out:
-      if (dctx) blosc2_free_ctx(dctx);
+      dctx_schunk->dctx = schunk_dctx;
       if (chunk && needs_free) free(chunk);
 
     }
 
     if (schunk) blosc2_schunk_free(schunk);
+    release_ctx(pooled_dctx, 0, &dctx_params);
 
   } /* compressing vs decompressing */
 
@@ -595,7 +1088,6 @@ size_t blosc2_filter_function(unsigned flags, size_t cd_nelmts,
 
   failed:
   if (outbuf) free(outbuf);
-  blosc2_destroy();
 
   return 0;
 
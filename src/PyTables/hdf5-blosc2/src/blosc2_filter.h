@@ -40,6 +40,28 @@ __declspec(dllexport)
 int32_t compute_blosc2_blocksize(int32_t chunksize, int32_t typesize,
                                  int clevel, int compcode);
 
+/* Decompresses the hyperslab [start, stop) of a chunk of rank ndim
+ * compressed by the filter as a B2ND array (cbuffer, of cbytes bytes)
+ * into buffer (of buffer_size bytes), in C order.
+ * Only the Blosc2 blocks which intersect the hyperslab are decompressed.
+ *
+ * Return the number of bytes written to buffer, or a negative value
+ * if there is some error, e.g. if the chunk is not a B2ND array. */
+#if defined(_MSC_VER)
+__declspec(dllexport)
+#endif	/* defined(_MSC_VER) */
+int64_t decompress_b2nd_chunk_slice(const void *cbuffer, size_t cbytes, int ndim,
+                                    const int64_t *start, const int64_t *stop,
+                                    void *buffer, size_t buffer_size);
+
+/* Releases the Blosc2 contexts kept for reuse across filter calls
+ * and the Blosc2 library resources.
+ * To call when the filter is no longer used, e.g., when unloading it. */
+#if defined(_MSC_VER)
+__declspec(dllexport)
+#endif	/* defined(_MSC_VER) */
+void release_blosc2_contexts(void);
+
 #ifdef __cplusplus
 }
 #endif
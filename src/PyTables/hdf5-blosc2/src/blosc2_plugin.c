@@ -38,3 +38,14 @@ H5PL_type_t H5PLget_plugin_type(void) { return H5PL_TYPE_FILTER; }
 
 
 const void* H5PLget_plugin_info(void) { return blosc2_H5Filter; }
+
+
+/* Free the Blosc2 contexts kept by the filter when the plugin is unloaded.
+ *
+ * Freeing contexts joins their threads, which must not be done from DllMain
+ * on Windows: it runs with the loader lock held and would deadlock.  There,
+ * the contexts (a few, see CTX_POOL_SIZE) are left to process termination. */
+#if defined(__GNUC__) && !defined(_WIN32)
+__attribute__((destructor))
+static void blosc2_plugin_unload(void) { release_blosc2_contexts(); }
+#endif
@@ -140,11 +140,10 @@ ext_bshuf = Extension(
         "bitshuffle/ext.pyx",
         "src/bitshuffle.c",
         "src/bitshuffle_core.c",
-        "src/iochain.c",
         "lz4/lz4.c",
     ],
     include_dirs=["src/", "lz4/"],
-    depends=["src/bitshuffle.h", "src/bitshuffle_core.h", "src/iochain.h", "lz4/lz4.h"],
+    depends=["src/bitshuffle.h", "src/bitshuffle_core.h", "lz4/lz4.h"],
     libraries=[],
     define_macros=MACROS,
 )
@@ -156,13 +155,11 @@ h5filter = Extension(
         "src/bshuf_h5filter.c",
         "src/bitshuffle.c",
         "src/bitshuffle_core.c",
-        "src/iochain.c",
         "lz4/lz4.c",
     ],
     depends=[
         "src/bitshuffle.h",
         "src/bitshuffle_core.h",
-        "src/iochain.h",
         "src/bshuf_h5filter.h",
         "lz4/lz4.h",
     ],
@@ -181,13 +178,11 @@ filter_plugin = Extension(
         "src/bshuf_h5filter.c",
         "src/bitshuffle.c",
         "src/bitshuffle_core.c",
-        "src/iochain.c",
         "lz4/lz4.c",
     ],
     depends=[
         "src/bitshuffle.h",
         "src/bitshuffle_core.h",
-        "src/iochain.h",
         "src/bshuf_h5filter.h",
         "lz4/lz4.h",
     ],
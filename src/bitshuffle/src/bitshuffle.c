@@ -13,6 +13,7 @@
 #include "bitshuffle_core.h"
 #include "bitshuffle_internals.h"
 #include "lz4.h"
+#include "lz4hc.h"
 
 #ifdef ZSTD_SUPPORT
 #include "zstd.h"
@@ -23,183 +24,274 @@
 
 
 // Macros.
-#define CHECK_ERR_FREE_LZ(count, buf) if (count < 0) {                      \
-    free(buf); return count - 1000; }
+#define CHECK_ERR_LZ(count) if (count < 0) { return count - 1000; }
 
 
-/* Bitshuffle and compress a single block. */
-int64_t bshuf_compress_lz4_block(ioc_chain *C_ptr, \
-        const size_t size, const size_t elem_size, const int option) {
+/* Bitshuffle and compress a single block. *option*, if not NULL, points to the
+ * compression level: positive for LZ4HC, negative for the LZ4 acceleration. */
+int64_t bshuf_compress_lz4_block(const void *in, void *out, const size_t out_size,
+        bshuf_scratch *scratch, const size_t size, const size_t elem_size,
+        const void* option) {
+
+    const int comp_lvl = (option == NULL) ? 0 : *(const int *) option;
 
     int64_t nbytes, count;
     void *tmp_buf_bshuf;
-    void *tmp_buf_lz4;
-    size_t this_iter;
-    const void *in;
-    void *out;
 
-    tmp_buf_bshuf = malloc(size * elem_size);
+    tmp_buf_bshuf = bshuf_scratch_get_buf(scratch, 0, size * elem_size);
     if (tmp_buf_bshuf == NULL) return -1;
 
     int dst_capacity = LZ4_compressBound(size * elem_size);
-    tmp_buf_lz4 = malloc(dst_capacity);
-    if (tmp_buf_lz4 == NULL){
-        free(tmp_buf_bshuf);
-        return -1;
-    }
+    if (out_size < (size_t) dst_capacity + 4) return -1;
 
-
-    in = ioc_get_in(C_ptr, &this_iter);
-    ioc_set_next_in(C_ptr, &this_iter, (void*) ((char*) in + size * elem_size));
+    // The compression state is reused for all blocks of the thread.
+    if (comp_lvl != 0 && scratch->ctx == NULL) {
+        scratch->ctx = malloc(comp_lvl > 0 ? LZ4_sizeofStateHC() : LZ4_sizeofState());
+        if (scratch->ctx == NULL) return -1;
+        scratch->free_ctx = &free;
+    }
 
     count = bshuf_trans_bit_elem(in, tmp_buf_bshuf, size, elem_size);
-    if (count < 0) {
-        free(tmp_buf_lz4);
-        free(tmp_buf_bshuf);
-        return count;
+    if (count < 0) return count;
+    if (comp_lvl > 0) {
+        nbytes = LZ4_compress_HC_extStateHC(scratch->ctx, (const char*) tmp_buf_bshuf,
+                (char*) out + 4, size * elem_size, dst_capacity, comp_lvl);
+    } else if (comp_lvl < 0) {
+        // Bounded to LZ4_ACCELERATION_MAX (65537), so that it can be negated.
+        nbytes = LZ4_compress_fast_extState(scratch->ctx, (const char*) tmp_buf_bshuf,
+                (char*) out + 4, size * elem_size, dst_capacity,
+                (comp_lvl < -65537) ? 65537 : -comp_lvl);
+    } else {
+        nbytes = LZ4_compress_default((const char*) tmp_buf_bshuf, (char*) out + 4,
+                size * elem_size, dst_capacity);
     }
-    nbytes = LZ4_compress_default((const char*) tmp_buf_bshuf, (char*) tmp_buf_lz4, size * elem_size, dst_capacity);
-    free(tmp_buf_bshuf);
-    CHECK_ERR_FREE_LZ(nbytes, tmp_buf_lz4);
-
-    out = ioc_get_out(C_ptr, &this_iter);
-    ioc_set_next_out(C_ptr, &this_iter, (void *) ((char *) out + nbytes + 4));
+    CHECK_ERR_LZ(nbytes);
 
     bshuf_write_uint32_BE(out, nbytes);
-    memcpy((char *) out + 4, tmp_buf_lz4, nbytes);
-
-    free(tmp_buf_lz4);
 
     return nbytes + 4;
 }
 
 
-/* Decompress and bitunshuffle a single block. */
-int64_t bshuf_decompress_lz4_block(ioc_chain *C_ptr,
-        const size_t size, const size_t elem_size, const int option) {
+/* Decompress and bitunshuffle the block at *in*. Returns the number of bytes
+ * read from *in*. */
+static int64_t bshuf_decompress_lz4_block_at(const void *in, void *out,
+        bshuf_scratch *scratch, const size_t size, const size_t elem_size,
+        const void *option) {
 
     int64_t nbytes, count;
-    void *out, *tmp_buf;
-    const void *in;
-    size_t this_iter;
+    void *tmp_buf;
     int32_t nbytes_from_header;
 
-    in = ioc_get_in(C_ptr, &this_iter);
     nbytes_from_header = bshuf_read_uint32_BE(in);
-    ioc_set_next_in(C_ptr, &this_iter,
-            (void*) ((char*) in + nbytes_from_header + 4));
 
-    out = ioc_get_out(C_ptr, &this_iter);
-    ioc_set_next_out(C_ptr, &this_iter,
-            (void *) ((char *) out + size * elem_size));
-
-    tmp_buf = malloc(size * elem_size);
+    tmp_buf = bshuf_scratch_get_buf(scratch, 0, size * elem_size);
     if (tmp_buf == NULL) return -1;
 
     nbytes = LZ4_decompress_safe((const char*) in + 4, (char *) tmp_buf, nbytes_from_header,
                                  size * elem_size);
-    CHECK_ERR_FREE_LZ(nbytes, tmp_buf);
-    if (nbytes != size * elem_size) {
-        free(tmp_buf);
-        return -91;
-    }
+    CHECK_ERR_LZ(nbytes);
+    if (nbytes != size * elem_size) return -91;
     nbytes = nbytes_from_header;
 
     count = bshuf_untrans_bit_elem(tmp_buf, out, size, elem_size);
-    CHECK_ERR_FREE(count, tmp_buf);
+    if (count < 0) return count;
     nbytes += 4;
 
-    free(tmp_buf);
     return nbytes;
 }
 
 #ifdef ZSTD_SUPPORT
+static void bshuf_free_zstd_cctx(void *ctx) {
+    ZSTD_freeCCtx((ZSTD_CCtx *) ctx);
+}
+
+
+static void bshuf_free_zstd_dctx(void *ctx) {
+    ZSTD_freeDCtx((ZSTD_DCtx *) ctx);
+}
+
+
+/* Settings of Zstd compression workers. */
+typedef struct bshuf_zstd_option {
+    int comp_lvl;
+    const ZSTD_CDict *cdict;    // Dictionary, if any, sets the level instead.
+} bshuf_zstd_option;
+
+
 /* Bitshuffle and compress a single block. */
-int64_t bshuf_compress_zstd_block(ioc_chain *C_ptr, \
-        const size_t size, const size_t elem_size, const int comp_lvl) {
+int64_t bshuf_compress_zstd_block(const void *in, void *out, const size_t out_size,
+        bshuf_scratch *scratch, const size_t size, const size_t elem_size,
+        const void* option) {
+
+    const bshuf_zstd_option *zstd_option = (const bshuf_zstd_option *) option;
 
     int64_t nbytes, count;
     void *tmp_buf_bshuf;
-    void *tmp_buf_zstd;
-    size_t this_iter;
-    const void *in;
-    void *out;
 
-    tmp_buf_bshuf = malloc(size * elem_size);
+    tmp_buf_bshuf = bshuf_scratch_get_buf(scratch, 0, size * elem_size);
     if (tmp_buf_bshuf == NULL) return -1;
 
-    size_t tmp_buf_zstd_size = ZSTD_compressBound(size * elem_size);
-    tmp_buf_zstd = malloc(tmp_buf_zstd_size);
-    if (tmp_buf_zstd == NULL){
-        free(tmp_buf_bshuf);
-        return -1;
-    }
+    size_t dst_capacity = ZSTD_compressBound(size * elem_size);
+    if (out_size < dst_capacity + 4) return -1;
 
-    in = ioc_get_in(C_ptr, &this_iter);
-    ioc_set_next_in(C_ptr, &this_iter, (void*) ((char*) in + size * elem_size));
+    // The compression context is reused for all blocks of the thread.
+    if (scratch->ctx == NULL) {
+        scratch->ctx = ZSTD_createCCtx();
+        if (scratch->ctx == NULL) return -1;
+        scratch->free_ctx = &bshuf_free_zstd_cctx;
+    }
 
     count = bshuf_trans_bit_elem(in, tmp_buf_bshuf, size, elem_size);
-    if (count < 0) {
-        free(tmp_buf_zstd);
-        free(tmp_buf_bshuf);
-        return count;
+    if (count < 0) return count;
+    if (zstd_option->cdict != NULL) {
+        nbytes = ZSTD_compress_usingCDict((ZSTD_CCtx *) scratch->ctx, (char *) out + 4,
+                dst_capacity, (const void*)tmp_buf_bshuf, size * elem_size,
+                zstd_option->cdict);
+    } else {
+        nbytes = ZSTD_compressCCtx((ZSTD_CCtx *) scratch->ctx, (char *) out + 4, dst_capacity,
+                (const void*)tmp_buf_bshuf, size * elem_size, zstd_option->comp_lvl);
     }
-    nbytes = ZSTD_compress(tmp_buf_zstd, tmp_buf_zstd_size, (const void*)tmp_buf_bshuf,  size * elem_size, comp_lvl);
-    free(tmp_buf_bshuf);
-    CHECK_ERR_FREE_LZ(nbytes, tmp_buf_zstd);
-
-    out = ioc_get_out(C_ptr, &this_iter);
-    ioc_set_next_out(C_ptr, &this_iter, (void *) ((char *) out + nbytes + 4));
+    CHECK_ERR_LZ(nbytes);
 
     bshuf_write_uint32_BE(out, nbytes);
-    memcpy((char *) out + 4, tmp_buf_zstd, nbytes);
-
-    free(tmp_buf_zstd);
 
     return nbytes + 4;
 }
 
 
-/* Decompress and bitunshuffle a single block. */
-int64_t bshuf_decompress_zstd_block(ioc_chain *C_ptr,
-        const size_t size, const size_t elem_size, const int option) {
+/* Decompress and bitunshuffle the block at *in*. Returns the number of bytes
+ * read from *in*. *option* is the ZSTD_DDict dictionary, if any. */
+static int64_t bshuf_decompress_zstd_block_at(const void *in, void *out,
+        bshuf_scratch *scratch, const size_t size, const size_t elem_size,
+        const void *option) {
 
     int64_t nbytes, count;
-    void *out, *tmp_buf;
-    const void *in;
-    size_t this_iter;
+    void *tmp_buf;
     int32_t nbytes_from_header;
 
-    in = ioc_get_in(C_ptr, &this_iter);
     nbytes_from_header = bshuf_read_uint32_BE(in);
-    ioc_set_next_in(C_ptr, &this_iter,
-            (void*) ((char*) in + nbytes_from_header + 4));
 
-    out = ioc_get_out(C_ptr, &this_iter);
-    ioc_set_next_out(C_ptr, &this_iter,
-            (void *) ((char *) out + size * elem_size));
-
-    tmp_buf = malloc(size * elem_size);
+    tmp_buf = bshuf_scratch_get_buf(scratch, 0, size * elem_size);
     if (tmp_buf == NULL) return -1;
 
-    nbytes = ZSTD_decompress(tmp_buf, size * elem_size, (void *)((char *) in + 4), nbytes_from_header);
-    CHECK_ERR_FREE_LZ(nbytes, tmp_buf);
-    if (nbytes != size * elem_size) {
-        free(tmp_buf);
-        return -91;
+    // The decompression context is reused for all blocks of the thread.
+    if (scratch->ctx == NULL) {
+        scratch->ctx = ZSTD_createDCtx();
+        if (scratch->ctx == NULL) return -1;
+        scratch->free_ctx = &bshuf_free_zstd_dctx;
+    }
+
+    if (option != NULL) {
+        nbytes = ZSTD_decompress_usingDDict((ZSTD_DCtx *) scratch->ctx, tmp_buf,
+                size * elem_size, (void *)((char *) in + 4), nbytes_from_header,
+                (const ZSTD_DDict *) option);
+    } else {
+        nbytes = ZSTD_decompressDCtx((ZSTD_DCtx *) scratch->ctx, tmp_buf, size * elem_size,
+                                     (void *)((char *) in + 4), nbytes_from_header);
     }
+    CHECK_ERR_LZ(nbytes);
+    if (nbytes != size * elem_size) return -91;
 
     nbytes = nbytes_from_header;
     count = bshuf_untrans_bit_elem(tmp_buf, out, size, elem_size);
-    CHECK_ERR_FREE(count, tmp_buf);
+    if (count < 0) return count;
     nbytes += 4;
 
-    free(tmp_buf);
     return nbytes;
 }
 #endif // ZSTD_SUPPORT
 
 
+/* Decompress the bytes [start, stop) of a buffer of compressed blocks. */
+static int64_t bshuf_decompress_range_fun(bshufDecompressBlockFunDef fun,
+        const void* in, void* out, const size_t size, const size_t elem_size,
+        size_t block_size, const size_t* offsets, const size_t start,
+        const size_t stop, const void* option) {
+
+    int64_t count = 0;
+    size_t ii, nblocks, first_block, end_block;
+    size_t block_bytes, blocks_bytes, last_block_size;
+    size_t offset, this_size, this_start, this_stop;
+    char *tmp_buf;
+    bshuf_scratch scratch;
+
+    if (block_size == 0) {
+        block_size = bshuf_default_block_size(elem_size);
+    }
+    if (block_size % BSHUF_BLOCKED_MULT) return -81;
+    if (start > stop || stop > size * elem_size) return -80;
+    if (start == stop) return 0;
+
+    last_block_size = size % block_size;
+    last_block_size = last_block_size - last_block_size % BSHUF_BLOCKED_MULT;
+    nblocks = size / block_size + (last_block_size ? 1 : 0);
+    block_bytes = block_size * elem_size;
+    blocks_bytes = (size - size % BSHUF_BLOCKED_MULT) * elem_size;
+
+    // Blocks containing the range.
+    first_block = (start < blocks_bytes) ? start / block_bytes : nblocks;
+    end_block = (stop < blocks_bytes) ? (stop - 1) / block_bytes + 1 : nblocks;
+
+    tmp_buf = (char *) malloc(block_bytes);
+    if (tmp_buf == NULL) return -1;
+    bshuf_scratch_init(&scratch);
+
+    // Without offsets, skip the preceding blocks using their headers.
+    offset = 0;
+    if (offsets == NULL) {
+        for (ii = 0; ii < first_block; ii++) {
+            offset += 4 + bshuf_read_uint32_BE((const char *) in + offset);
+        }
+    }
+
+    for (ii = first_block; ii < end_block && count >= 0; ii++) {
+        this_size = (ii == size / block_size) ? last_block_size : block_size;
+        if (offsets != NULL) {
+            offset = offsets[ii];
+            // The block header must agree with the offsets before it is read.
+            if (4 + (size_t) bshuf_read_uint32_BE((const char *) in + offset)
+                    != offsets[ii + 1] - offset) {
+                count = -91;
+                break;
+            }
+        }
+
+        count = fun((const char *) in + offset, tmp_buf, &scratch, this_size,
+                elem_size, option);
+        if (count < 0) break;
+        offset += count;
+
+        this_start = (start > ii * block_bytes) ? start - ii * block_bytes : 0;
+        this_stop = stop - ii * block_bytes;
+        if (this_stop > this_size * elem_size) this_stop = this_size * elem_size;
+        memcpy((char *) out + ii * block_bytes + this_start - start,
+                tmp_buf + this_start, this_stop - this_start);
+    }
+
+    bshuf_scratch_free(&scratch);
+    free(tmp_buf);
+    if (count < 0) return count;
+
+    // Leftover bytes not fitting into any blocks are stored after the blocks.
+    if (stop > blocks_bytes) {
+        if (offsets != NULL) {
+            offset = offsets[nblocks];
+        } else {
+            for (; ii < nblocks; ii++) {
+                offset += 4 + bshuf_read_uint32_BE((const char *) in + offset);
+            }
+        }
+        this_start = (start > blocks_bytes) ? start : blocks_bytes;
+        memcpy((char *) out + this_start - start,
+                (const char *) in + offset + this_start - blocks_bytes,
+                stop - this_start);
+    }
+
+    return stop - start;
+}
+
+
 /* ---- Public functions ----
  *
  * See header file for description and usage.
@@ -230,15 +322,39 @@ size_t bshuf_compress_lz4_bound(const size_t size,
 
 int64_t bshuf_compress_lz4(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size) {
-    return bshuf_blocked_wrap_fun(&bshuf_compress_lz4_block, in, out, size,
-            elem_size, block_size, 0/*option*/);
+    return bshuf_blocked_direct_wrap_fun(&bshuf_compress_lz4_block,
+            &bshuf_compress_lz4_bound, in, out, size, elem_size, block_size,
+            NULL/*option*/);
+}
+
+
+int64_t bshuf_compress_lz4_level(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const int comp_lvl) {
+    return bshuf_blocked_direct_wrap_fun(&bshuf_compress_lz4_block,
+            &bshuf_compress_lz4_bound, in, out, size, elem_size, block_size,
+            &comp_lvl);
 }
 
 
 int64_t bshuf_decompress_lz4(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size) {
-    return bshuf_blocked_wrap_fun(&bshuf_decompress_lz4_block, in, out, size,
-            elem_size, block_size, 0/*option*/);
+    return bshuf_blocked_offsets_wrap_fun(&bshuf_decompress_lz4_block_at, in,
+            out, size, elem_size, block_size, NULL, NULL/*option*/);
+}
+
+
+int64_t bshuf_decompress_lz4_offsets(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets) {
+    return bshuf_blocked_offsets_wrap_fun(&bshuf_decompress_lz4_block_at, in,
+            out, size, elem_size, block_size, offsets, NULL/*option*/);
+}
+
+
+int64_t bshuf_decompress_lz4_range(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets,
+        const size_t start, const size_t stop) {
+    return bshuf_decompress_range_fun(&bshuf_decompress_lz4_block_at, in, out,
+            size, elem_size, block_size, offsets, start, stop, NULL/*option*/);
 }
 
 #ifdef ZSTD_SUPPORT
@@ -266,14 +382,41 @@ size_t bshuf_compress_zstd_bound(const size_t size,
 
 int64_t bshuf_compress_zstd(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size, const int comp_lvl) {
-    return bshuf_blocked_wrap_fun(&bshuf_compress_zstd_block, in, out, size,
-            elem_size, block_size, comp_lvl);
+    bshuf_zstd_option option = {comp_lvl, NULL};
+    return bshuf_blocked_direct_wrap_fun(&bshuf_compress_zstd_block,
+            &bshuf_compress_zstd_bound, in, out, size, elem_size, block_size,
+            &option);
+}
+
+
+int64_t bshuf_compress_zstd_dict(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const ZSTD_CDict* cdict) {
+    bshuf_zstd_option option = {0, cdict};
+    return bshuf_blocked_direct_wrap_fun(&bshuf_compress_zstd_block,
+            &bshuf_compress_zstd_bound, in, out, size, elem_size, block_size,
+            &option);
 }
 
 
 int64_t bshuf_decompress_zstd(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size) {
-    return bshuf_blocked_wrap_fun(&bshuf_decompress_zstd_block, in, out, size,
-            elem_size, block_size, 0/*option*/);
+    return bshuf_blocked_offsets_wrap_fun(&bshuf_decompress_zstd_block_at, in,
+            out, size, elem_size, block_size, NULL, NULL/*option*/);
+}
+
+
+int64_t bshuf_decompress_zstd_offsets(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets,
+        const ZSTD_DDict* ddict) {
+    return bshuf_blocked_offsets_wrap_fun(&bshuf_decompress_zstd_block_at, in,
+            out, size, elem_size, block_size, offsets, ddict);
+}
+
+
+int64_t bshuf_decompress_zstd_range(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets,
+        const size_t start, const size_t stop, const ZSTD_DDict* ddict) {
+    return bshuf_decompress_range_fun(&bshuf_decompress_zstd_block_at, in, out,
+            size, elem_size, block_size, offsets, start, stop, ddict);
 }
 #endif // ZSTD_SUPPORT
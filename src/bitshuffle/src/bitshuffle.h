@@ -89,6 +89,32 @@ int64_t bshuf_compress_lz4(const void* in, void* out, const size_t size, const s
         elem_size, size_t block_size);
 
 
+/* ---- bshuf_compress_lz4_level ----
+ *
+ * Same as *bshuf_compress_lz4*, with a compression level. The output is
+ * decompressed by *bshuf_decompress_lz4*.
+ *
+ * Parameters
+ * ----------
+ *  in : input buffer, must be of size * elem_size bytes
+ *  out : output buffer, must be large enough to hold data.
+ *  size : number of elements in input
+ *  elem_size : element size of typed data
+ *  block_size : Process in blocks of this many elements. Pass 0 to
+ *  select automatically (recommended).
+ *  comp_lvl : 0 for the default LZ4 compression, 1 to 12 for LZ4HC
+ *  compression at that level, negative for faster LZ4 compression with an
+ *  acceleration factor of -comp_lvl.
+ *
+ * Returns
+ * -------
+ *  number of bytes used in output buffer, negative error-code if failed.
+ *
+ */
+int64_t bshuf_compress_lz4_level(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const int comp_lvl);
+
+
 /* ---- bshuf_decompress_lz4 ----
  *
  * Undo compression and bitshuffling.
@@ -115,11 +141,73 @@ int64_t bshuf_compress_lz4(const void* in, void* out, const size_t size, const s
 int64_t bshuf_decompress_lz4(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size);
 
+
+/* ---- bshuf_decompress_lz4_offsets ----
+ *
+ * Undo compression and bitshuffling, given the location of the blocks.
+ *
+ * Same as *bshuf_decompress_lz4*, but all the blocks are decompressed in
+ * parallel since their offsets in *in* are known in advance.
+ * *bshuf_decompress_lz4* finds them by scanning the block headers first.
+ *
+ * Parameters
+ * ----------
+ *  in : input buffer
+ *  out : output buffer, must be of size * elem_size bytes
+ *  size : number of elements in input
+ *  elem_size : element size of typed data
+ *  block_size : Process in blocks of this many elements. Pass 0 to
+ *  select automatically (recommended).
+ *  offsets : Offsets in *in* of each block and of the data following the
+ *  last block, or NULL to find them from the block headers.
+ *
+ * Returns
+ * -------
+ *  number of bytes consumed in *input* buffer, negative error-code if failed.
+ *
+ */
+int64_t bshuf_decompress_lz4_offsets(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets);
+
+
+/* ---- bshuf_decompress_lz4_range ----
+ *
+ * Undo compression and bitshuffling for part of the data.
+ *
+ * Only decompress and un-bitshuffle the blocks containing the bytes [*start*,
+ * *stop*) of the uncompressed data, and write those bytes to *out*.
+ *
+ * Parameters
+ * ----------
+ *  in : input buffer
+ *  out : output buffer, must be of size stop - start bytes
+ *  size : number of elements in the uncompressed data
+ *  elem_size : element size of typed data
+ *  block_size : Process in blocks of this many elements. Pass 0 to
+ *  select automatically (recommended).
+ *  offsets : Offsets in *in* of each block and of the data following the
+ *  last block, or NULL to find them from the headers of preceding blocks.
+ *  start : offset of the first byte to decompress
+ *  stop : offset following the last byte to decompress
+ *
+ * Returns
+ * -------
+ *  number of bytes written in *output* buffer, negative error-code if failed.
+ *
+ */
+int64_t bshuf_decompress_lz4_range(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets,
+        const size_t start, const size_t stop);
+
 /*
  * ---- ZSTD Interface ----
  */
 
 #ifdef ZSTD_SUPPORT
+/* Digested Zstd dictionaries, ZSTD_CDict and ZSTD_DDict in zstd.h. */
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
 /* ---- bshuf_compress_zstd_bound ----
  *
  * Bound on size of data compressed with *bshuf_compress_zstd*.
@@ -170,6 +258,21 @@ int64_t bshuf_compress_zstd(const void* in, void* out, const size_t size, const
         elem_size, size_t block_size, const int comp_lvl);
 
 
+/* ---- bshuf_compress_zstd_dict ----
+ *
+ * Bitshuffle then compress data with Zstd using a dictionary.
+ *
+ * Same as *bshuf_compress_zstd*, but each block is compressed with the
+ * digested dictionary *cdict* (a ZSTD_CDict), which also sets the compression
+ * level. Small blocks compress much better with a dictionary trained on
+ * similar data. Decompress with *bshuf_decompress_zstd_offsets* and the
+ * matching ZSTD_DDict.
+ *
+ */
+int64_t bshuf_compress_zstd_dict(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const struct ZSTD_CDict_s* cdict);
+
+
 /* ---- bshuf_decompress_zstd ----
  *
  * Undo compression and bitshuffling.
@@ -196,6 +299,32 @@ int64_t bshuf_compress_zstd(const void* in, void* out, const size_t size, const
 int64_t bshuf_decompress_zstd(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size);
 
+
+/* ---- bshuf_decompress_zstd_offsets ----
+ *
+ * Undo compression and bitshuffling, given the location of the blocks.
+ *
+ * See *bshuf_decompress_lz4_offsets*. *ddict* is the digested dictionary (a
+ * ZSTD_DDict) used for compression, or NULL if none.
+ *
+ */
+int64_t bshuf_decompress_zstd_offsets(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets,
+        const struct ZSTD_DDict_s* ddict);
+
+
+/* ---- bshuf_decompress_zstd_range ----
+ *
+ * Undo compression and bitshuffling for part of the data.
+ *
+ * See *bshuf_decompress_lz4_range*. *ddict* is the digested dictionary (a
+ * ZSTD_DDict) used for compression, or NULL if none.
+ *
+ */
+int64_t bshuf_decompress_zstd_range(const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const size_t* offsets,
+        const size_t start, const size_t stop, const struct ZSTD_DDict_s* ddict);
+
 #endif // ZSTD_SUPPORT
 
 #ifdef __cplusplus
@@ -15,16 +15,53 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 
-#if defined(__AVX512F__) && defined (__AVX512BW__) && defined(__AVX2__) && defined(__SSE2__)
+/* On x86-64, all the SIMD variants are compiled and the best one supported by
+ * the CPU is selected at run time. */
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(BSHUF_NO_RUNTIME_DISPATCH) \
+    && ((defined(__clang__) && __clang_major__ >= 10) \
+        || (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 5) \
+        || defined(_MSC_VER))
+#define BSHUF_RUNTIME_DISPATCH
 #define USEAVX512
+#define USEAVX2
+#define USESSE2
+#endif
+
+// Enable instruction sets for code compiled for run time selection.
+#if defined(BSHUF_RUNTIME_DISPATCH) && defined(__clang__)
+#define BSHUF_TARGET_AVX2_BEGIN _Pragma("clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)")
+#define BSHUF_TARGET_AVX512_BEGIN _Pragma("clang attribute push (__attribute__((target(\"avx2,avx512f,avx512bw\"))), apply_to = function)")
+#define BSHUF_TARGET_END _Pragma("clang attribute pop")
+#elif defined(BSHUF_RUNTIME_DISPATCH) && defined(__GNUC__)
+#define BSHUF_TARGET_AVX2_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define BSHUF_TARGET_AVX512_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,avx512f,avx512bw\")")
+#define BSHUF_TARGET_END _Pragma("GCC pop_options")
+#else
+#define BSHUF_TARGET_AVX2_BEGIN
+#define BSHUF_TARGET_AVX512_BEGIN
+#define BSHUF_TARGET_END
+#endif
+
+#if defined(BSHUF_RUNTIME_DISPATCH) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(BSHUF_RUNTIME_DISPATCH)
+#include <cpuid.h>
 #endif
 
-#if defined(__AVX2__) && defined (__SSE2__)
+#if !defined(BSHUF_RUNTIME_DISPATCH) && defined(__AVX512F__) && defined (__AVX512BW__) && defined(__AVX2__) && defined(__SSE2__)
+#define USEAVX512
+#endif
+
+#if !defined(BSHUF_RUNTIME_DISPATCH) && defined(__AVX2__) && defined (__SSE2__)
 #define USEAVX2
 #endif
 
-#if defined(__SSE2__) || defined(NO_WARN_X86_INTRINSICS)
+#if !defined(BSHUF_RUNTIME_DISPATCH) && (defined(__SSE2__) || defined(NO_WARN_X86_INTRINSICS))
 #define USESSE2
 #endif
 
@@ -53,42 +90,122 @@ typedef size_t omp_size_t;
 #define CHECK_MULT_EIGHT(n) if (n % 8) return -80;
 #define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
 
+// Instruction sets, from the least to the most preferred.
+#define SIMD_UNKNOWN -1
+#define SIMD_SCALAR 0
+#define SIMD_NEON 1
+#define SIMD_SSE2 2
+#define SIMD_AVX2 3
+#define SIMD_AVX512 4
 
-/* ---- Functions indicating compile time instruction set. ---- */
 
-int bshuf_using_NEON(void) {
-#ifdef USEARMNEON
-    return 1;
+/* ---- Functions selecting the instruction set. ---- */
+
+static int bshuf_simd = SIMD_UNKNOWN;
+
+
+#ifdef BSHUF_RUNTIME_DISPATCH
+static void bshuf_cpuid(const int leaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, 0);
+    regs[0] = info[0]; regs[1] = info[1]; regs[2] = info[2]; regs[3] = info[3];
 #else
-    return 0;
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
 #endif
 }
 
 
-int bshuf_using_SSE2(void) {
-#ifdef USESSE2
-    return 1;
+/* Register states enabled by the OS (XCR0). */
+static uint64_t bshuf_xgetbv(void) {
+#ifdef _MSC_VER
+    return _xgetbv(0);
 #else
-    return 0;
+    uint32_t eax, edx;
+    __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return ((uint64_t) edx << 32) | eax;
 #endif
 }
+#endif
 
 
-int bshuf_using_AVX2(void) {
-#ifdef USEAVX2
-    return 1;
+/* Returns the best instruction set supported by both the build and the CPU. */
+static int bshuf_select_simd(void) {
+#ifdef BSHUF_RUNTIME_DISPATCH
+    uint32_t regs[4];
+    uint64_t xcr0 = 0;
+    int avx2 = 0, avx512 = 0;
+
+    bshuf_cpuid(0, regs);
+    if (regs[0] >= 7) {
+        bshuf_cpuid(1, regs);
+        if (regs[2] & (1u << 27)) {  // OSXSAVE
+            xcr0 = bshuf_xgetbv();
+        }
+        bshuf_cpuid(7, regs);
+        // AVX2 with XMM and YMM states enabled
+        avx2 = (regs[1] & (1u << 5)) && (xcr0 & 0x6) == 0x6;
+        // AVX512F and AVX512BW with opmask and ZMM states also enabled
+        avx512 = avx2 && (regs[1] & (1u << 16)) && (regs[1] & (1u << 30))
+            && (xcr0 & 0xe0) == 0xe0;
+    }
+    if (avx512) return SIMD_AVX512;
+    if (avx2) return SIMD_AVX2;
+    return SIMD_SSE2;  // Always available on x86-64
+#elif defined(USEAVX512)
+    return SIMD_AVX512;
+#elif defined(USEAVX2)
+    return SIMD_AVX2;
+#elif defined(USESSE2)
+    return SIMD_SSE2;
+#elif defined(USEARMNEON)
+    return SIMD_NEON;
 #else
-    return 0;
+    return SIMD_SCALAR;
 #endif
 }
 
 
+/* Returns the instruction set to use, selecting it on first call. */
+static int bshuf_get_simd_level(void) {
+    int simd = bshuf_simd;
+    if (simd == SIMD_UNKNOWN) {
+        // Concurrent first calls all store the same value.
+        simd = bshuf_select_simd();
+        bshuf_simd = simd;
+    }
+    return simd;
+}
+
+
+const char* bshuf_get_simd(void) {
+    switch (bshuf_get_simd_level()) {
+        case SIMD_AVX512: return "avx512";
+        case SIMD_AVX2: return "avx2";
+        case SIMD_SSE2: return "sse2";
+        case SIMD_NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+
+int bshuf_using_NEON(void) {
+    return bshuf_get_simd_level() == SIMD_NEON;
+}
+
+
+int bshuf_using_SSE2(void) {
+    return bshuf_get_simd_level() >= SIMD_SSE2;
+}
+
+
+int bshuf_using_AVX2(void) {
+    return bshuf_get_simd_level() >= SIMD_AVX2;
+}
+
+
 int bshuf_using_AVX512(void) {
-#ifdef USEAVX512
-    return 1;
-#else
-    return 0;
-#endif
+    return bshuf_get_simd_level() == SIMD_AVX512;
 }
 
 /* ---- Worker code not requiring special instruction sets. ----
@@ -1396,6 +1513,8 @@ int64_t bshuf_shuffle_bit_eightelem_SSE(const void* in, void* out, const size_t
  */
 
 #ifdef USEAVX2
+BSHUF_TARGET_AVX2_BEGIN
+
 /* Transpose bits within bytes. */
 int64_t bshuf_trans_bit_byte_AVX(const void* in, void* out, const size_t size,
          const size_t elem_size) {
@@ -1603,6 +1722,7 @@ int64_t bshuf_untrans_bit_elem_AVX(const void* in, void* out, const size_t size,
 }
 
 
+BSHUF_TARGET_END
 #else // #ifdef USEAVX2
 
 int64_t bshuf_trans_bit_byte_AVX(const void* in, void* out, const size_t size,
@@ -1637,6 +1757,7 @@ int64_t bshuf_untrans_bit_elem_AVX(const void* in, void* out, const size_t size,
 #endif // #ifdef USEAVX2
 
 #ifdef USEAVX512
+BSHUF_TARGET_AVX512_BEGIN
 
 /* Transpose bits within bytes. */
 int64_t bshuf_trans_bit_byte_AVX512(const void* in, void* out, const size_t size,
@@ -1767,6 +1888,7 @@ int64_t bshuf_untrans_bit_elem_AVX512(const void* in, void* out, const size_t si
     return count;
 }
 
+BSHUF_TARGET_END
 #else // #ifdef USEAVX512
 
 int64_t bshuf_trans_bit_byte_AVX512(const void* in, void* out, const size_t size,
@@ -1793,152 +1915,295 @@ int64_t bshuf_untrans_bit_elem_AVX512(const void* in, void* out, const size_t si
 
 #endif
 
-/* ---- Drivers selecting best instruction set at compile time. ---- */
+/* ---- Drivers selecting best instruction set. ---- */
 
 int64_t bshuf_trans_bit_elem(const void* in, void* out, const size_t size, 
         const size_t elem_size) {
 
-    int64_t count;
-#ifdef USEAVX512
-    count = bshuf_trans_bit_elem_AVX512(in, out, size, elem_size);
-#elif defined USEAVX2
-    count = bshuf_trans_bit_elem_AVX(in, out, size, elem_size);
-#elif defined(USESSE2)
-    count = bshuf_trans_bit_elem_SSE(in, out, size, elem_size);
-#elif defined(USEARMNEON)
-    count = bshuf_trans_bit_elem_NEON(in, out, size, elem_size);
-#else
-    count = bshuf_trans_bit_elem_scal(in, out, size, elem_size);
-#endif
-    return count;
+    switch (bshuf_get_simd_level()) {
+        case SIMD_AVX512:
+            return bshuf_trans_bit_elem_AVX512(in, out, size, elem_size);
+        case SIMD_AVX2:
+            return bshuf_trans_bit_elem_AVX(in, out, size, elem_size);
+        case SIMD_SSE2:
+            return bshuf_trans_bit_elem_SSE(in, out, size, elem_size);
+        case SIMD_NEON:
+            return bshuf_trans_bit_elem_NEON(in, out, size, elem_size);
+        default:
+            return bshuf_trans_bit_elem_scal(in, out, size, elem_size);
+    }
 }
 
 
 int64_t bshuf_untrans_bit_elem(const void* in, void* out, const size_t size, 
         const size_t elem_size) {
 
-    int64_t count;
-#ifdef USEAVX512
-    count = bshuf_untrans_bit_elem_AVX512(in, out, size, elem_size);
-#elif defined USEAVX2
-    count = bshuf_untrans_bit_elem_AVX(in, out, size, elem_size);
-#elif defined(USESSE2)
-    count = bshuf_untrans_bit_elem_SSE(in, out, size, elem_size);
-#elif defined(USEARMNEON)
-    count = bshuf_untrans_bit_elem_NEON(in, out, size, elem_size);
-#else
-    count = bshuf_untrans_bit_elem_scal(in, out, size, elem_size);
-#endif
-    return count;
+    switch (bshuf_get_simd_level()) {
+        case SIMD_AVX512:
+            return bshuf_untrans_bit_elem_AVX512(in, out, size, elem_size);
+        case SIMD_AVX2:
+            return bshuf_untrans_bit_elem_AVX(in, out, size, elem_size);
+        case SIMD_SSE2:
+            return bshuf_untrans_bit_elem_SSE(in, out, size, elem_size);
+        case SIMD_NEON:
+            return bshuf_untrans_bit_elem_NEON(in, out, size, elem_size);
+        default:
+            return bshuf_untrans_bit_elem_scal(in, out, size, elem_size);
+    }
 }
 
 
 /* ---- Wrappers for implementing blocking ---- */
 
-/* Wrap a function for processing a single block to process an entire buffer in
- * parallel. */
-int64_t bshuf_blocked_wrap_fun(bshufBlockFunDef fun, const void* in, void* out, \
-        const size_t size, const size_t elem_size, size_t block_size, const int option) {
+void bshuf_scratch_init(bshuf_scratch* scratch) {
+    scratch->buf[0] = scratch->buf[1] = NULL;
+    scratch->buf_size[0] = scratch->buf_size[1] = 0;
+    scratch->ctx = NULL;
+    scratch->free_ctx = NULL;
+}
 
-    omp_size_t ii = 0;
-    int64_t err = 0;
-    int64_t count, cum_count=0;
-    size_t last_block_size;
-    size_t leftover_bytes;
-    size_t this_iter;
-    char *last_in;
-    char *last_out;
+
+void* bshuf_scratch_get_buf(bshuf_scratch* scratch, const int index,
+        const size_t size) {
+
+    if (scratch->buf_size[index] < size) {
+        free(scratch->buf[index]);
+        scratch->buf[index] = malloc(size);
+        scratch->buf_size[index] = (scratch->buf[index] == NULL) ? 0 : size;
+    }
+    return scratch->buf[index];
+}
+
+
+void bshuf_scratch_free(bshuf_scratch* scratch) {
+    free(scratch->buf[0]);
+    free(scratch->buf[1]);
+    if (scratch->ctx != NULL && scratch->free_ctx != NULL) {
+        scratch->free_ctx(scratch->ctx);
+    }
+    bshuf_scratch_init(scratch);
+}
 
 
-    ioc_chain C;
-    ioc_init(&C, in, out);
+/* Wrap a function decompressing a single block to decompress an entire buffer
+ * in parallel.
+ *
+ * Compressed blocks have variable sizes, so their offsets are needed before
+ * any block but the first can be decompressed. Without *offsets*, they are
+ * found with a quick scan of the 4 byte block headers, after which all blocks
+ * are decompressed independently.
+ */
+int64_t bshuf_blocked_offsets_wrap_fun(bshufDecompressBlockFunDef fun,
+        const void* in, void* out, const size_t size, const size_t elem_size,
+        size_t block_size, const size_t* offsets, const void* option) {
 
+    omp_size_t ii = 0;
+    int64_t err = 0;
+    size_t nblocks, last_block_size, leftover_bytes;
+    size_t block_bytes, blocks_end;
+    size_t *scanned = NULL;
 
     if (block_size == 0) {
         block_size = bshuf_default_block_size(elem_size);
     }
     if (block_size % BSHUF_BLOCKED_MULT) return -81;
 
+    last_block_size = size % block_size;
+    last_block_size = last_block_size - last_block_size % BSHUF_BLOCKED_MULT;
+    nblocks = size / block_size + (last_block_size ? 1 : 0);
+    block_bytes = block_size * elem_size;
+
+    if (offsets == NULL) {
+        scanned = (size_t *) malloc((nblocks + 1) * sizeof(size_t));
+        if (scanned == NULL) return -1;
+        scanned[0] = 0;
+        for (ii = 0; ii < (omp_size_t) nblocks; ii++) {
+            scanned[ii + 1] = scanned[ii] + 4
+                    + bshuf_read_uint32_BE((const char *) in + scanned[ii]);
+        }
+        offsets = scanned;
+    }
+
+    // Each thread allocates its scratch space once for all its blocks.
 #if defined(_OPENMP)
-    #pragma omp parallel for schedule(dynamic, 1) \
-            private(count) reduction(+ : cum_count)
+    #pragma omp parallel
 #endif
-    for (ii = 0; ii < (omp_size_t)( size / block_size ); ii ++) {
-        count = fun(&C, block_size, elem_size, option);
-        if (count < 0) err = count;
-        cum_count += count;
-    }
+    {
+        int64_t count;
+        bshuf_scratch scratch;
+        bshuf_scratch_init(&scratch);
 
-    last_block_size = size % block_size;
-    last_block_size = last_block_size - last_block_size % BSHUF_BLOCKED_MULT;
-    if (last_block_size) {
-        count = fun(&C, last_block_size, elem_size, option);
-        if (count < 0) err = count;
-        cum_count += count;
+#if defined(_OPENMP)
+        #pragma omp for schedule(dynamic, 1)
+#endif
+        for (ii = 0; ii < (omp_size_t) nblocks; ii++) {
+            // Blocks must exactly fill the space between their offsets, which
+            // is checked from the block header before decompressing.
+            if (4 + (size_t) bshuf_read_uint32_BE((const char *) in + offsets[ii])
+                    != offsets[ii + 1] - offsets[ii]) {
+                count = -91;
+            } else {
+                count = fun((const char *) in + offsets[ii],
+                        (char *) out + ii * block_bytes, &scratch,
+                        ((size_t) ii == size / block_size) ? last_block_size : block_size,
+                        elem_size, option);
+            }
+            if (count < 0) err = count;
+        }
+
+        bshuf_scratch_free(&scratch);
     }
 
+    blocks_end = offsets[nblocks];
+    free(scanned);
     if (err < 0) return err;
 
     leftover_bytes = size % BSHUF_BLOCKED_MULT * elem_size;
-    //this_iter;
-    last_in = (char *) ioc_get_in(&C, &this_iter);
-    ioc_set_next_in(&C, &this_iter, (void *) (last_in + leftover_bytes));
-    last_out = (char *) ioc_get_out(&C, &this_iter);
-    ioc_set_next_out(&C, &this_iter, (void *) (last_out + leftover_bytes));
+    memcpy((char *) out + (size - size % BSHUF_BLOCKED_MULT) * elem_size,
+            (const char *) in + blocks_end, leftover_bytes);
 
-    memcpy(last_out, last_in, leftover_bytes);
+    return blocks_end + leftover_bytes;
+}
 
-    ioc_destroy(&C);
 
-    return cum_count + leftover_bytes;
-}
+/* Wrap a function for processing a single block to process an entire buffer in
+ * parallel, without locks.
+ *
+ * Each thread processes a contiguous range of blocks. Without *bound*, blocks
+ * are written in place. Otherwise, the first thread writes to *out* and the
+ * others to their own buffer sized with *bound*, which are then copied after
+ * the output of the previous threads, once all the output sizes are known.
+ */
+int64_t bshuf_blocked_direct_wrap_fun(bshufBlockDirectFunDef fun,
+        bshufBoundFunDef bound, const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const void* option) {
 
+    int64_t err = 0, total = 0;
+    int64_t *thread_count;
+    int max_threads = 1;
+    size_t nblocks, last_block_size, leftover_bytes;
+    size_t block_bytes;
 
-/* Bitshuffle a single block. */
-int64_t bshuf_bitshuffle_block(ioc_chain *C_ptr, \
-        const size_t size, const size_t elem_size, const int option) {
+    if (block_size == 0) {
+        block_size = bshuf_default_block_size(elem_size);
+    }
+    if (block_size % BSHUF_BLOCKED_MULT) return -81;
 
-    size_t this_iter;
-    const void *in;
-    void *out;
-    int64_t count;
+    nblocks = size / block_size;
+    last_block_size = size % block_size;
+    last_block_size = last_block_size - last_block_size % BSHUF_BLOCKED_MULT;
+    block_bytes = block_size * elem_size;
 
+#if defined(_OPENMP)
+    max_threads = omp_get_max_threads();
+    if ((size_t) max_threads > nblocks + (last_block_size ? 1 : 0)) {
+        max_threads = (int) (nblocks + (last_block_size ? 1 : 0));
+    }
+    if (max_threads < 1) max_threads = 1;
+#endif
 
-    
-    in = ioc_get_in(C_ptr, &this_iter);
-    ioc_set_next_in(C_ptr, &this_iter,
-            (void*) ((char*) in + size * elem_size));
-    out = ioc_get_out(C_ptr, &this_iter);
-    ioc_set_next_out(C_ptr, &this_iter,
-            (void *) ((char *) out + size * elem_size));
+    // Output size of each thread, then offset of each thread output.
+    thread_count = (int64_t *) calloc(max_threads + 1, sizeof(int64_t));
+    if (thread_count == NULL) return -1;
 
-    count = bshuf_trans_bit_elem(in, out, size, elem_size);
-    return count;
-}
+#if defined(_OPENMP)
+    #pragma omp parallel num_threads(max_threads)
+#endif
+    {
+        int tid = 0, nthreads = 1;
+        size_t ii, first, end, this_size;
+        size_t capacity, written = 0;
+        int64_t count = 0;
+        const char *this_in;
+        char *this_out;
+        bshuf_scratch scratch;
 
+#if defined(_OPENMP)
+        tid = omp_get_thread_num();
+        nthreads = omp_get_num_threads();
+#endif
+        first = nblocks * tid / nthreads;
+        end = nblocks * (tid + 1) / nthreads;
+        // The last thread also takes the last partial block.
+        this_size = (end - first) * block_size;
+        if (tid == nthreads - 1) this_size += last_block_size;
+
+        this_in = (const char *) in + first * block_bytes;
+        if (bound == NULL) {
+            capacity = this_size * elem_size;
+            this_out = (char *) out + first * block_bytes;
+        } else {
+            capacity = bound(this_size, elem_size, block_size);
+            this_out = (tid == 0) ? (char *) out : (char *) malloc(capacity);
+            if (this_out == NULL) count = -1;
+        }
 
-/* Bitunshuffle a single block. */
-int64_t bshuf_bitunshuffle_block(ioc_chain* C_ptr, \
-        const size_t size, const size_t elem_size, const int option) {
+        bshuf_scratch_init(&scratch);
+        for (ii = first; ii < end && count >= 0; ii++) {
+            count = fun(this_in, this_out + written, capacity - written,
+                    &scratch, block_size, elem_size, option);
+            if (count >= 0) written += count;
+            this_in += block_bytes;
+        }
+        if (tid == nthreads - 1 && last_block_size && count >= 0) {
+            count = fun(this_in, this_out + written, capacity - written,
+                    &scratch, last_block_size, elem_size, option);
+            if (count >= 0) written += count;
+        }
+        bshuf_scratch_free(&scratch);
 
+        thread_count[tid + 1] = (count < 0) ? count : (int64_t) written;
 
-    size_t this_iter;
-    const void *in;
-    void *out;
-    int64_t count;
+#if defined(_OPENMP)
+        #pragma omp barrier
+        #pragma omp single
+#endif
+        {
+            for (ii = 0; ii < (size_t) nthreads; ii++) {
+                if (thread_count[ii + 1] < 0) {
+                    err = thread_count[ii + 1];
+                    break;
+                }
+                thread_count[ii + 1] += thread_count[ii];
+            }
+            total = thread_count[nthreads];
+        }
+
+        if (bound != NULL && tid != 0 && this_out != NULL) {
+            if (err == 0) {
+                memcpy((char *) out + thread_count[tid], this_out, written);
+            }
+            free(this_out);
+        }
+    }
+
+    free(thread_count);
+    if (err < 0) return err;
 
+    leftover_bytes = size % BSHUF_BLOCKED_MULT * elem_size;
+    memcpy((char *) out + total,
+            (const char *) in + (size - size % BSHUF_BLOCKED_MULT) * elem_size,
+            leftover_bytes);
 
+    return total + leftover_bytes;
+}
 
 
-    in = ioc_get_in(C_ptr, &this_iter);
-    ioc_set_next_in(C_ptr, &this_iter,
-            (void*) ((char*) in + size * elem_size));
-    out = ioc_get_out(C_ptr, &this_iter);
-    ioc_set_next_out(C_ptr, &this_iter,
-            (void *) ((char *) out + size * elem_size));
+/* Bitshuffle a single block. */
+int64_t bshuf_bitshuffle_block(const void* in, void* out, const size_t out_size,
+        bshuf_scratch* scratch, const size_t size, const size_t elem_size,
+        const void* option) {
 
-    count = bshuf_untrans_bit_elem(in, out, size, elem_size);
-    return count;
+    return bshuf_trans_bit_elem(in, out, size, elem_size);
+}
+
+
+/* Bitunshuffle a single block. */
+int64_t bshuf_bitunshuffle_block(const void* in, void* out, const size_t out_size,
+        bshuf_scratch* scratch, const size_t size, const size_t elem_size,
+        const void* option) {
+
+    return bshuf_untrans_bit_elem(in, out, size, elem_size);
 }
 
 
@@ -2012,16 +2277,16 @@ size_t bshuf_default_block_size(const size_t elem_size) {
 int64_t bshuf_bitshuffle(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size) {
 
-    return bshuf_blocked_wrap_fun(&bshuf_bitshuffle_block, in, out, size,
-            elem_size, block_size, 0/*option*/);
+    return bshuf_blocked_direct_wrap_fun(&bshuf_bitshuffle_block, NULL, in, out,
+            size, elem_size, block_size, NULL/*option*/);
 }
 
 
 int64_t bshuf_bitunshuffle(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size) {
 
-    return bshuf_blocked_wrap_fun(&bshuf_bitunshuffle_block, in, out, size,
-            elem_size, block_size, 0/*option*/);
+    return bshuf_blocked_direct_wrap_fun(&bshuf_bitunshuffle_block, NULL, in, out,
+            size, elem_size, block_size, NULL/*option*/);
 }
 
 
@@ -56,9 +56,25 @@
 extern "C" {
 #endif
 
+/* ---- bshuf_get_simd ----
+ *
+ * Name of the instruction set used by the routines.
+ *
+ * On x86-64, routines are compiled for SSE2, AVX2 and AVX512 and the best
+ * instruction set supported by the CPU is selected at run time. Elsewhere,
+ * the instruction set is selected at compile time.
+ *
+ * Returns
+ * -------
+ *  "avx512", "avx2", "sse2", "neon" or "scalar".
+ *
+ */
+const char* bshuf_get_simd(void);
+
+
 /* --- bshuf_using_SSE2 ----
  *
- * Whether routines where compiled with the SSE2 instruction set.
+ * Whether routines are using the SSE2 instruction set.
  *
  * Returns
  * -------
@@ -70,7 +86,7 @@ int bshuf_using_SSE2(void);
 
 /* ---- bshuf_using_NEON ----
  *
- * Whether routines where compiled with the NEON instruction set.
+ * Whether routines are using the NEON instruction set.
  *
  * Returns
  * -------
@@ -82,7 +98,7 @@ int bshuf_using_NEON(void);
 
 /* ---- bshuf_using_AVX2 ----
  *
- * Whether routines where compiled with the AVX2 instruction set.
+ * Whether routines are using the AVX2 instruction set.
  *
  * Returns
  * -------
@@ -94,7 +110,7 @@ int bshuf_using_AVX2(void);
 
 /* ---- bshuf_using_AVX512 ----
  *
- * Whether routines where compiled with the AVX512 instruction set.
+ * Whether routines are using the AVX512 instruction set.
  *
  * Returns
  * -------
@@ -26,7 +26,6 @@
 #endif
 
 #include <stdlib.h>
-#include "iochain.h"
 
 
 // Constants.
@@ -59,14 +58,59 @@ void bshuf_write_uint32_BE(void* buf, uint32_t num);
 int64_t bshuf_untrans_bit_elem(const void* in, void* out, const size_t size,
         const size_t elem_size);
 
-/* Function definition for worker functions that process a single block. */
-typedef int64_t (*bshufBlockFunDef)(ioc_chain* C_ptr,
-        const size_t size, const size_t elem_size, const int option);
-
-/* Wrap a function for processing a single block to process an entire buffer in
- * parallel. */
-int64_t bshuf_blocked_wrap_fun(bshufBlockFunDef fun, const void* in, void* out,
-        const size_t size, const size_t elem_size, size_t block_size, const int option);
+/* Scratch space of a worker thread, reused for all the blocks it processes
+ * within a call. */
+typedef struct bshuf_scratch {
+    void* buf[2];
+    size_t buf_size[2];
+    void* ctx;                      // Codec context, if any.
+    void (*free_ctx)(void* ctx);    // Function releasing ctx.
+} bshuf_scratch;
+
+/* Initialize empty scratch space. */
+void bshuf_scratch_init(bshuf_scratch* scratch);
+
+/* Get scratch buffer *index* (0 or 1) holding at least *size* bytes.
+ * Returns NULL if allocation fails. */
+void* bshuf_scratch_get_buf(bshuf_scratch* scratch, const int index,
+        const size_t size);
+
+/* Release scratch buffers and codec context. */
+void bshuf_scratch_free(bshuf_scratch* scratch);
+
+/* Function definition for worker functions that process a single block read
+ * from *in* and write it to *out*, which can hold *out_size* bytes. Returns
+ * the number of bytes written. *option* points to worker specific settings,
+ * if any. */
+typedef int64_t (*bshufBlockDirectFunDef)(const void* in, void* out,
+        const size_t out_size, bshuf_scratch* scratch, const size_t size,
+        const size_t elem_size, const void* option);
+
+/* Function definition for the upper bound of the output size of a buffer
+ * processed with a bshufBlockDirectFunDef. */
+typedef size_t (*bshufBoundFunDef)(const size_t size, const size_t elem_size,
+        size_t block_size);
+
+/* Wrap a function for processing a single block, whose input blocks are
+ * contiguous, to process an entire buffer in parallel without locks. If
+ * *bound* is NULL, output blocks have the same size as input blocks. */
+int64_t bshuf_blocked_direct_wrap_fun(bshufBlockDirectFunDef fun,
+        bshufBoundFunDef bound, const void* in, void* out, const size_t size,
+        const size_t elem_size, size_t block_size, const void* option);
+
+/* Function definition for worker functions that decompress the single block
+ * at *in* to *out*. Returns the number of bytes read from *in*. */
+typedef int64_t (*bshufDecompressBlockFunDef)(const void* in, void* out,
+        bshuf_scratch* scratch, const size_t size, const size_t elem_size,
+        const void* option);
+
+/* Wrap a function decompressing a single block to decompress an entire buffer
+ * in parallel. *offsets* holds the offset in *in* of each block and of the
+ * data following the last block. If NULL, they are found from the block
+ * headers before decompressing. */
+int64_t bshuf_blocked_offsets_wrap_fun(bshufDecompressBlockFunDef fun,
+        const void* in, void* out, const size_t size, const size_t elem_size,
+        size_t block_size, const size_t* offsets, const void* option);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -13,6 +13,17 @@
 #include "bitshuffle.h"
 #include "bshuf_h5filter.h"
 
+#include <string.h>
+
+#ifdef ZSTD_SUPPORT
+#include "zstd.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
 
 #define PUSH_ERR(func, minor, str)                                      \
     H5Epush1(__FILE__, func, __LINE__, H5E_PLINE, minor, str)
@@ -25,6 +36,258 @@ void bshuf_write_uint32_BE(void* buf, uint32_t num);
 uint32_t bshuf_read_uint32_BE(const void* buf);
 
 
+// Number of blocks of a buffer of *size* elements. The last block holds the
+// remaining elements rounded down to a multiple of 8, if any.
+static size_t bshuf_h5_nblocks(const size_t size, const size_t block_size) {
+    return size / block_size + (size % block_size >= 8 ? 1 : 0);
+}
+
+
+// Offsets of the blocks of a compressed chunk of *nbytes_uncomp* bytes
+// relative to *blocks*, followed by the offset of the leftover bytes. They are
+// read from the block offsets *table* if not NULL, otherwise from the block
+// headers. *avail* is the number of bytes from *blocks* to the end of the
+// chunk. A table is only checked to be increasing and within the chunk: the
+// header of each block is checked against it when the block is decompressed.
+// Returns NULL if allocation fails or if the blocks are inconsistent with the
+// chunk.
+static size_t* bshuf_h5_read_offsets(const char* table, const char* blocks,
+        const size_t avail, const size_t nbytes_uncomp, const size_t block_size,
+        const size_t elem_size) {
+
+    size_t ii, nblocks, leftover_bytes;
+    size_t size = nbytes_uncomp / elem_size;
+    size_t *offsets;
+
+    nblocks = bshuf_h5_nblocks(size, block_size);
+    // Elements not fitting in a block and bytes not making a whole element.
+    leftover_bytes = (size % 8) * elem_size + nbytes_uncomp % elem_size;
+    offsets = (size_t*) malloc((nblocks + 1) * sizeof(size_t));
+    if (offsets == NULL) return NULL;
+
+    offsets[0] = (table != NULL) ? bshuf_read_uint32_BE(table) : 0;
+    for (ii = 0; ii < nblocks; ii++) {
+        // Each block holds at least its 4-byte header.
+        if (avail < 4 || offsets[ii] > avail - 4) break;
+        if (table != NULL) {
+            offsets[ii + 1] = bshuf_read_uint32_BE(table + 4 * (ii + 1));
+            if (offsets[ii + 1] < offsets[ii] + 4) break;
+        } else {
+            offsets[ii + 1] = offsets[ii] + 4
+                + bshuf_read_uint32_BE(blocks + offsets[ii]);
+        }
+    }
+    if (ii < nblocks || offsets[nblocks] > avail
+            || avail - offsets[nblocks] < leftover_bytes) {
+        free(offsets);
+        return NULL;
+    }
+    return offsets;
+}
+
+
+// Copy *size* little-endian elements from *in* to *out*, zeroing their
+// *nplanes* least significant bit planes. Inlined with constant *elem_size*
+// for the common sizes, so that the loop is vectorized.
+//
+// The planes are masked in a copy before bitshuffling rather than in the
+// bit-transpose kernels, which are shared with the block compressors: it
+// costs one more pass over the chunk, and leaves HDF5's buffer untouched
+// should compression fail. The number of planes is given by the user, it is
+// not estimated from the noise of the data.
+static inline void bshuf_h5_truncate_planes_elem(const unsigned char* in,
+        unsigned char* out, const size_t size, const size_t elem_size,
+        const unsigned int nplanes) {
+
+    size_t ii, jj;
+    unsigned char mask[8];
+
+    // Elements are integers or floats of at most 8 bytes, see set_local.
+    for (jj = 0; jj < elem_size; jj++) {
+        mask[jj] = (8 * (jj + 1) <= nplanes) ? 0 :
+            (8 * jj >= nplanes) ? 0xff : (unsigned char) (0xff << (nplanes % 8));
+    }
+    for (ii = 0; ii < size * elem_size; ii += elem_size) {
+        for (jj = 0; jj < elem_size; jj++) out[ii + jj] = in[ii + jj] & mask[jj];
+    }
+}
+
+
+static void bshuf_h5_truncate_planes(const void* in, void* out,
+        const size_t size, const size_t elem_size, const unsigned int nplanes) {
+    switch (elem_size) {
+        case 1:
+            bshuf_h5_truncate_planes_elem(in, out, size, 1, nplanes);
+            break;
+        case 2:
+            bshuf_h5_truncate_planes_elem(in, out, size, 2, nplanes);
+            break;
+        case 4:
+            bshuf_h5_truncate_planes_elem(in, out, size, 4, nplanes);
+            break;
+        case 8:
+            bshuf_h5_truncate_planes_elem(in, out, size, 8, nplanes);
+            break;
+        default:
+            bshuf_h5_truncate_planes_elem(in, out, size, elem_size, nplanes);
+            break;
+    }
+}
+
+
+#ifdef ZSTD_SUPPORT
+// Zstd dictionaries registered with bshuf_register_zstd_dict. They are kept
+// until bshuf_release_zstd_dicts along with their digested forms, which are
+// shared by all the blocks and chunks using them.
+typedef struct bshuf_h5_zstd_cdict {
+    int comp_lvl;
+    ZSTD_CDict* cdict;
+    struct bshuf_h5_zstd_cdict* next;
+} bshuf_h5_zstd_cdict;
+
+typedef struct bshuf_h5_zstd_dict {
+    unsigned int id;
+    void* dict;
+    size_t dict_size;
+    ZSTD_DDict* ddict;
+    bshuf_h5_zstd_cdict* cdicts;    // One per compression level in use.
+    struct bshuf_h5_zstd_dict* next;
+} bshuf_h5_zstd_dict;
+
+static bshuf_h5_zstd_dict* zstd_dicts = NULL;
+
+#if defined(_WIN32)
+static SRWLOCK zstd_dicts_lock = SRWLOCK_INIT;
+#define LOCK_ZSTD_DICTS() AcquireSRWLockExclusive(&zstd_dicts_lock)
+#define UNLOCK_ZSTD_DICTS() ReleaseSRWLockExclusive(&zstd_dicts_lock)
+#else
+static pthread_mutex_t zstd_dicts_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_ZSTD_DICTS() pthread_mutex_lock(&zstd_dicts_lock)
+#define UNLOCK_ZSTD_DICTS() pthread_mutex_unlock(&zstd_dicts_lock)
+#endif
+
+
+// Registered dictionary *id*, NULL if none. Call with the lock held.
+static bshuf_h5_zstd_dict* bshuf_h5_find_zstd_dict(const unsigned int id) {
+    bshuf_h5_zstd_dict* entry;
+    for (entry = zstd_dicts; entry != NULL; entry = entry->next) {
+        if (entry->id == id) return entry;
+    }
+    return NULL;
+}
+
+
+// Digested dictionary *id* for decompression, NULL if not registered.
+static const ZSTD_DDict* bshuf_h5_get_zstd_ddict(const unsigned int id) {
+    bshuf_h5_zstd_dict* entry;
+    LOCK_ZSTD_DICTS();
+    entry = bshuf_h5_find_zstd_dict(id);
+    UNLOCK_ZSTD_DICTS();
+    return (entry != NULL) ? entry->ddict : NULL;
+}
+
+
+// Digested dictionary *id* for compression at *comp_lvl*, created on first
+// use. NULL if not registered or if allocation fails.
+static const ZSTD_CDict* bshuf_h5_get_zstd_cdict(const unsigned int id,
+        const int comp_lvl) {
+    bshuf_h5_zstd_dict* entry;
+    bshuf_h5_zstd_cdict* cdict_entry = NULL;
+    const ZSTD_CDict* cdict = NULL;
+
+    LOCK_ZSTD_DICTS();
+    entry = bshuf_h5_find_zstd_dict(id);
+    if (entry != NULL) {
+        for (cdict_entry = entry->cdicts; cdict_entry != NULL;
+                cdict_entry = cdict_entry->next) {
+            if (cdict_entry->comp_lvl == comp_lvl) break;
+        }
+        if (cdict_entry == NULL) {
+            cdict_entry = (bshuf_h5_zstd_cdict*) malloc(sizeof(bshuf_h5_zstd_cdict));
+            if (cdict_entry != NULL) {
+                cdict_entry->comp_lvl = comp_lvl;
+                cdict_entry->cdict = ZSTD_createCDict(entry->dict,
+                        entry->dict_size, comp_lvl);
+                if (cdict_entry->cdict == NULL) {
+                    free(cdict_entry);
+                    cdict_entry = NULL;
+                } else {
+                    cdict_entry->next = entry->cdicts;
+                    entry->cdicts = cdict_entry;
+                }
+            }
+        }
+        if (cdict_entry != NULL) cdict = cdict_entry->cdict;
+    }
+    UNLOCK_ZSTD_DICTS();
+    return cdict;
+}
+#endif
+
+
+int64_t bshuf_register_zstd_dict(const void* dict, const size_t dict_size) {
+#ifdef ZSTD_SUPPORT
+    bshuf_h5_zstd_dict* entry;
+    unsigned int id;
+
+    // Only dictionaries with a header, as trained by zstd, have an ID.
+    id = ZSTD_getDictID_fromDict(dict, dict_size);
+    if (id == 0) return -1;
+
+    LOCK_ZSTD_DICTS();
+    if (bshuf_h5_find_zstd_dict(id) == NULL) {
+        entry = (bshuf_h5_zstd_dict*) calloc(1, sizeof(bshuf_h5_zstd_dict));
+        if (entry != NULL) entry->dict = malloc(dict_size);
+        if (entry == NULL || entry->dict == NULL) {
+            free(entry);
+            UNLOCK_ZSTD_DICTS();
+            return -1;
+        }
+        memcpy(entry->dict, dict, dict_size);
+        entry->dict_size = dict_size;
+        entry->id = id;
+        entry->ddict = ZSTD_createDDict(entry->dict, dict_size);
+        if (entry->ddict == NULL) {
+            free(entry->dict);
+            free(entry);
+            UNLOCK_ZSTD_DICTS();
+            return -1;
+        }
+        entry->next = zstd_dicts;
+        zstd_dicts = entry;
+    }
+    UNLOCK_ZSTD_DICTS();
+    return id;
+#else
+    return -1;
+#endif
+}
+
+
+void bshuf_release_zstd_dicts(void) {
+#ifdef ZSTD_SUPPORT
+    bshuf_h5_zstd_dict* entry;
+    bshuf_h5_zstd_cdict* cdict_entry;
+
+    LOCK_ZSTD_DICTS();
+    while (zstd_dicts != NULL) {
+        entry = zstd_dicts;
+        zstd_dicts = entry->next;
+        while (entry->cdicts != NULL) {
+            cdict_entry = entry->cdicts;
+            entry->cdicts = cdict_entry->next;
+            ZSTD_freeCDict(cdict_entry->cdict);
+            free(cdict_entry);
+        }
+        ZSTD_freeDDict(entry->ddict);
+        free(entry->dict);
+        free(entry);
+    }
+    UNLOCK_ZSTD_DICTS();
+#endif
+}
+
+
 // Only called on compression, not on reverse.
 herr_t bshuf_h5_set_local(hid_t dcpl, hid_t type, hid_t space){
 
@@ -32,6 +295,7 @@ herr_t bshuf_h5_set_local(hid_t dcpl, hid_t type, hid_t space){
     size_t ii;
 
     unsigned int elem_size;
+    size_t mpos, msize, max_planes;
 
     unsigned int flags;
     size_t nelements = 8;
@@ -87,6 +351,52 @@ herr_t bshuf_h5_set_local(hid_t dcpl, hid_t type, hid_t space){
                          "Invalid bitshuffle compression.");
         }
     }
+    if (nelements > 6) {
+        if (values[6] != 0 && values[6] != BSHUF_H5_FORMAT_BLOCK_OFFSETS) {
+            PUSH_ERR("bshuf_h5_set_local", H5E_CALLBACK,
+                     "Invalid bitshuffle chunk format.");
+            return -1;
+        }
+    }
+    if (nelements > 8 && values[8] != 0) {
+        if ((H5Tget_class(type) != H5T_INTEGER && H5Tget_class(type) != H5T_FLOAT)
+                || elem_size > 8
+                || (elem_size > 1 && H5Tget_order(type) != H5T_ORDER_LE)) {
+            PUSH_ERR("bshuf_h5_set_local", H5E_CALLBACK,
+                     "Bit plane truncation requires little-endian integers or floats.");
+            return -1;
+        }
+        // Keep the sign and exponent of floats, only truncate the mantissa.
+        max_planes = 8 * elem_size;
+        if (H5Tget_class(type) == H5T_FLOAT) {
+            if (H5Tget_fields(type, NULL, NULL, NULL, &mpos, &msize) < 0) return -1;
+            max_planes = mpos + msize;
+        }
+        if (values[8] > max_planes) {
+            sprintf(msg, "Invalid number of truncated bit planes: %u (max %u).",
+                    values[8], (unsigned int) max_planes);
+            PUSH_ERR("bshuf_h5_set_local", H5E_CALLBACK, msg);
+            return -1;
+        }
+    }
+    if (nelements > 7 && values[7] != 0) {
+#ifdef ZSTD_SUPPORT
+        if (values[4] != BSHUF_H5_COMPRESS_ZSTD) {
+            PUSH_ERR("bshuf_h5_set_local", H5E_CALLBACK,
+                     "Zstd dictionary requires Zstd compression.");
+            return -1;
+        }
+        if (bshuf_h5_get_zstd_ddict(values[7]) == NULL) {
+            sprintf(msg, "Zstd dictionary %u is not registered.", values[7]);
+            PUSH_ERR("bshuf_h5_set_local", H5E_CALLBACK, msg);
+            return -1;
+        }
+#else
+        PUSH_ERR("bshuf_h5_set_local", H5E_CALLBACK,
+                 "Zstd dictionary chosen but ZSTD support not installed.");
+        return -1;
+#endif
+    }
 
     r = H5Pmodify_filter(dcpl, BSHUF_H5FILTER, flags, nelements, values);
     if(r<0) return -1;
@@ -99,13 +409,21 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
            const unsigned int cd_values[], size_t nbytes,
            size_t *buf_size, void **buf) {
 
-    size_t size, elem_size;
+    size_t size, elem_size, extra_bytes;
     int err = -1;
     char msg[80];
     size_t block_size = 0;
     size_t buf_size_out, nbytes_uncomp, nbytes_out;
+    size_t ii, nblocks, table_size = 0;
+    size_t *offsets;
+    int format = 0;
     char* in_buf = *buf;
+    char* truncated_buf = NULL;
     void *out_buf;
+#ifdef ZSTD_SUPPORT
+    const ZSTD_CDict* cdict = NULL;
+    const ZSTD_DDict* ddict = NULL;
+#endif
 
     if (cd_nelmts < 3) {
         PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK, 
@@ -113,15 +431,16 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
         return 0;
     }
     elem_size = cd_values[2];
-#ifdef ZSTD_SUPPORT
-    const int comp_lvl = cd_values[5]; 
-#endif
+    const int comp_lvl = (cd_nelmts > 5) ? (int) cd_values[5] : 0;
 
     // User specified block size.
     if (cd_nelmts > 3) block_size = cd_values[3];
 
     if (block_size == 0) block_size = bshuf_default_block_size(elem_size);
-    
+
+    // Chunk format.
+    if (cd_nelmts > 6) format = cd_values[6];
+
 #ifndef ZSTD_SUPPORT
     if (cd_nelmts > 4 && (cd_values[4] == BSHUF_H5_COMPRESS_ZSTD)) {
         PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK, 
@@ -130,6 +449,22 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
     }
 #endif
 
+#ifdef ZSTD_SUPPORT
+    // Zstd dictionary, which must be registered in this process.
+    if (cd_nelmts > 7 && cd_values[7] != 0 && cd_values[4] == BSHUF_H5_COMPRESS_ZSTD) {
+        if (flags & H5Z_FLAG_REVERSE) {
+            ddict = bshuf_h5_get_zstd_ddict(cd_values[7]);
+        } else {
+            cdict = bshuf_h5_get_zstd_cdict(cd_values[7], comp_lvl);
+        }
+        if (ddict == NULL && cdict == NULL) {
+            sprintf(msg, "Zstd dictionary %u is not registered.", cd_values[7]);
+            PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK, msg);
+            return 0;
+        }
+    }
+#endif
+
     // Compression in addition to bitshuffle.
     if (cd_nelmts > 4 && (cd_values[4] == BSHUF_H5_COMPRESS_LZ4 || cd_values[4] == BSHUF_H5_COMPRESS_ZSTD)) {
         if (flags & H5Z_FLAG_REVERSE) {
@@ -138,20 +473,36 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
             nbytes_uncomp = bshuf_read_uint64_BE(in_buf);
             // Override the block size with the one read from the header.
             block_size = bshuf_read_uint32_BE((const char*) in_buf + 8) / elem_size;
-            // Skip over the header.
-            in_buf += 12;
+            if (block_size == 0) {
+                PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK,
+                        "Invalid block size in header.");
+                return 0;
+            }
+            // Skip over the header and the block offsets table.
+            if (format == BSHUF_H5_FORMAT_BLOCK_OFFSETS) {
+                table_size = 4 * (bshuf_h5_nblocks(nbytes_uncomp / elem_size, block_size) + 1);
+            }
+            if (nbytes < 12 + table_size) {
+                PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK,
+                        "Compressed chunk too small.");
+                return 0;
+            }
+            in_buf += 12 + table_size;
             buf_size_out = nbytes_uncomp;
         } else {
             nbytes_uncomp = nbytes;
+            if (format == BSHUF_H5_FORMAT_BLOCK_OFFSETS) {
+                table_size = 4 * (bshuf_h5_nblocks(nbytes_uncomp / elem_size, block_size) + 1);
+            }
             // Pick which compressions library to use
             if(cd_values[4] == BSHUF_H5_COMPRESS_LZ4) {
               buf_size_out = bshuf_compress_lz4_bound(nbytes_uncomp / elem_size, 
-                  elem_size, block_size) + 12;
+                  elem_size, block_size) + 12 + table_size + nbytes_uncomp % elem_size;
             }
 #ifdef ZSTD_SUPPORT
             else if (cd_values[4] == BSHUF_H5_COMPRESS_ZSTD) {
               buf_size_out = bshuf_compress_zstd_bound(nbytes_uncomp / elem_size, 
-                  elem_size, block_size) + 12;
+                  elem_size, block_size) + 12 + table_size + nbytes_uncomp % elem_size;
             }
 #endif
         }
@@ -160,33 +511,65 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
         buf_size_out = nbytes;
     }
 
-    // TODO, remove this restriction by memcopying the extra.
-    if (nbytes_uncomp % elem_size) {
-        PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK, 
-                "Non integer number of elements.");
-        return 0;
-    }
+    // Bytes not making a whole element, e.g., the checksum of a previous
+    // Fletcher32 filter, are copied through after the processed elements.
     size = nbytes_uncomp / elem_size;
+    extra_bytes = nbytes_uncomp % elem_size;
+
+    // Lossy bit plane truncation, done on a copy before bitshuffling.
+    if (!(flags & H5Z_FLAG_REVERSE) && cd_nelmts > 8 && cd_values[8] != 0) {
+        if (elem_size > 8 || cd_values[8] > 8 * elem_size) {
+            PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK,
+                    "Invalid number of truncated bit planes.");
+            return 0;
+        }
+        truncated_buf = malloc(nbytes);
+        if (truncated_buf == NULL) {
+            PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK,
+                    "Could not allocate truncation buffer.");
+            return 0;
+        }
+        bshuf_h5_truncate_planes(in_buf, truncated_buf, size, elem_size, cd_values[8]);
+        memcpy(truncated_buf + size * elem_size, in_buf + size * elem_size, extra_bytes);
+        in_buf = truncated_buf;
+    }
 
     out_buf = malloc(buf_size_out);
     if (out_buf == NULL) {
         PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK, 
                 "Could not allocate output buffer.");
+        free(truncated_buf);
         return 0;
     }
 
     if (cd_nelmts > 4 && (cd_values[4] == BSHUF_H5_COMPRESS_LZ4 || cd_values[4] == BSHUF_H5_COMPRESS_ZSTD)) {
         if (flags & H5Z_FLAG_REVERSE) {
             // Bit unshuffle/decompress.
+            // Locate all the blocks first, so they are decompressed in parallel.
+            offsets = bshuf_h5_read_offsets(table_size ? in_buf - table_size : NULL,
+                    in_buf, nbytes - 12 - table_size, nbytes_uncomp, block_size,
+                    elem_size);
+            if (offsets == NULL) {
+                PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK,
+                        "Invalid or truncated compressed blocks.");
+                free(out_buf);
+                return 0;
+            }
             // Pick which compressions library to use
             if(cd_values[4] == BSHUF_H5_COMPRESS_LZ4) {
-              err = bshuf_decompress_lz4(in_buf, out_buf, size, elem_size, block_size);
+              err = bshuf_decompress_lz4_offsets(in_buf, out_buf, size, elem_size,
+                      block_size, offsets);
             }
 #ifdef ZSTD_SUPPORT
             else if (cd_values[4] == BSHUF_H5_COMPRESS_ZSTD) {
-              err = bshuf_decompress_zstd(in_buf, out_buf, size, elem_size, block_size);
+              err = bshuf_decompress_zstd_offsets(in_buf, out_buf, size, elem_size,
+                      block_size, offsets, ddict);
             }
 #endif
+            if (err >= 0) {
+                memcpy((char*) out_buf + size * elem_size, in_buf + err, extra_bytes);
+            }
+            free(offsets);
             nbytes_out = nbytes_uncomp;
         } else {
             // Bit shuffle/compress.
@@ -198,16 +581,36 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
             bshuf_write_uint64_BE(out_buf, nbytes_uncomp);
             bshuf_write_uint32_BE((char*) out_buf + 8, block_size * elem_size);
             if(cd_values[4] == BSHUF_H5_COMPRESS_LZ4) {
-                err = bshuf_compress_lz4(in_buf, (char*) out_buf + 12, size,
-                        elem_size, block_size); 
+                err = bshuf_compress_lz4_level(in_buf, (char*) out_buf + 12 + table_size,
+                        size, elem_size, block_size, comp_lvl);
             }
 #ifdef ZSTD_SUPPORT
+            else if (cd_values[4] == BSHUF_H5_COMPRESS_ZSTD && cdict != NULL) {
+                err = bshuf_compress_zstd_dict(in_buf, (char*) out_buf + 12 + table_size,
+                        size, elem_size, block_size, cdict);
+            }
             else if (cd_values[4] == BSHUF_H5_COMPRESS_ZSTD) {
-                err = bshuf_compress_zstd(in_buf, (char*) out_buf + 12, size,
+                err = bshuf_compress_zstd(in_buf, (char*) out_buf + 12 + table_size, size,
                         elem_size, block_size, comp_lvl); 
             }
 #endif
-            nbytes_out = err + 12;
+            if (table_size && err >= 0) {
+                // Fill the block offsets table from the block headers.
+                char* table = (char*) out_buf + 12;
+                char* blocks = table + table_size;
+                size_t offset = 0;
+                nblocks = table_size / 4 - 1;
+                for (ii = 0; ii < nblocks; ii++) {
+                    bshuf_write_uint32_BE(table + 4 * ii, offset);
+                    offset += 4 + bshuf_read_uint32_BE(blocks + offset);
+                }
+                bshuf_write_uint32_BE(table + 4 * nblocks, offset);
+            }
+            if (err >= 0) {
+                memcpy((char*) out_buf + 12 + table_size + err,
+                        in_buf + size * elem_size, extra_bytes);
+            }
+            nbytes_out = err + 12 + table_size + extra_bytes;
         } 
     } else {
             if (flags & H5Z_FLAG_REVERSE) {
@@ -216,10 +619,15 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
                     block_size); } else {
             // Bit shuffle.
             err = bshuf_bitshuffle(in_buf, out_buf, size, elem_size,
-                    block_size); } nbytes_out = nbytes; }
+                    block_size); }
+            memcpy((char*) out_buf + size * elem_size, in_buf + size * elem_size,
+                    extra_bytes);
+            nbytes_out = nbytes; }
     //printf("nb_in %d, nb_uncomp %d, nb_out %d, buf_out %d, block %d\n",
     //nbytes, nbytes_uncomp, nbytes_out, buf_size_out, block_size);
 
+    free(truncated_buf);
+
     if (err < 0) {
         sprintf(msg, "Error in bitshuffle with error code %d.", err);
         PUSH_ERR("bshuf_h5_filter", H5E_CALLBACK, msg);
@@ -236,6 +644,74 @@ size_t bshuf_h5_filter(unsigned int flags, size_t cd_nelmts,
 
 
 
+int64_t bshuf_decompress_range(const void* chunk, const size_t chunk_size,
+        const size_t cd_nelmts, const unsigned int cd_values[],
+        const size_t start, const size_t stop, void* out) {
+
+    size_t elem_size, block_size, nbytes_uncomp, table_size = 0;
+    size_t size, elem_bytes, elem_start, elem_stop, extra_start;
+    size_t *offsets;
+    const char *blocks;
+    int64_t err = -1;
+
+    if (cd_nelmts < 5 || cd_values[2] == 0) return -1;
+    elem_size = cd_values[2];
+    if (chunk_size < 12) return -1;
+
+    nbytes_uncomp = bshuf_read_uint64_BE((void*) chunk);
+    block_size = bshuf_read_uint32_BE((const char*) chunk + 8) / elem_size;
+    if (block_size == 0) return -1;
+    if (start > stop || stop > nbytes_uncomp) return -1;
+    size = nbytes_uncomp / elem_size;
+    elem_bytes = size * elem_size;
+
+    if (cd_nelmts > 6 && cd_values[6] == BSHUF_H5_FORMAT_BLOCK_OFFSETS) {
+        table_size = 4 * (bshuf_h5_nblocks(size, block_size) + 1);
+        if (chunk_size < 12 + table_size) return -1;
+    }
+    blocks = (const char*) chunk + 12 + table_size;
+
+    offsets = bshuf_h5_read_offsets(table_size ? blocks - table_size : NULL,
+            blocks, chunk_size - 12 - table_size, nbytes_uncomp, block_size,
+            elem_size);
+    if (offsets == NULL) return -1;
+
+    // Bytes not making a whole element are handled after the elements.
+    elem_start = (start < elem_bytes) ? start : elem_bytes;
+    elem_stop = (stop < elem_bytes) ? stop : elem_bytes;
+
+    if (cd_values[4] == BSHUF_H5_COMPRESS_LZ4) {
+        err = bshuf_decompress_lz4_range(blocks, out, size, elem_size,
+                block_size, offsets, elem_start, elem_stop);
+    }
+#ifdef ZSTD_SUPPORT
+    else if (cd_values[4] == BSHUF_H5_COMPRESS_ZSTD) {
+        const ZSTD_DDict* ddict = NULL;
+        if (cd_nelmts > 7 && cd_values[7] != 0) {
+            ddict = bshuf_h5_get_zstd_ddict(cd_values[7]);
+        }
+        if (cd_nelmts <= 7 || cd_values[7] == 0 || ddict != NULL) {
+            err = bshuf_decompress_zstd_range(blocks, out, size, elem_size,
+                    block_size, offsets, elem_start, elem_stop, ddict);
+        }
+    }
+#endif
+
+    if (err >= 0 && stop > elem_bytes) {
+        extra_start = (start > elem_bytes) ? start : elem_bytes;
+        memcpy((char*) out + extra_start - start,
+                blocks + offsets[bshuf_h5_nblocks(size, block_size)]
+                + (size % 8) * elem_size + extra_start - elem_bytes,
+                stop - extra_start);
+        err = stop - start;
+    }
+
+    free(offsets);
+    return err;
+}
+
+
+
 H5Z_class_t bshuf_H5Filter[1] = {{
     H5Z_CLASS_T_VERS,
     (H5Z_filter_t)(BSHUF_H5FILTER),
@@ -25,6 +25,40 @@
  *      For LZ4 compression, the compressed format of the data is the same as
  *      for the normal LZ4 filter described in
  *      http://www.hdfgroup.org/services/filters/HDF5_LZ4.pdf.
+ *  Compression level (option slot 2) : integer (optional)
+ *      Compression level used for Zstd compression. For LZ4 compression,
+ *      1 to 12 selects LZ4HC at that level and a negative value selects
+ *      faster LZ4 compression with an acceleration factor of minus the
+ *      value, stored as a 32 bit two's complement integer. Default is 0.
+ *      Decompression does not depend on it.
+ *  Chunk format (option slot 3) : 0 or BSHUF_H5_FORMAT_BLOCK_OFFSETS (optional)
+ *      Format of compressed chunks. With BSHUF_H5_FORMAT_BLOCK_OFFSETS, the
+ *      12 bytes header is followed by a table of big endian 4 bytes offsets
+ *      of each block, relative to the first block, and of the data
+ *      following the last block. This allows to decompress only the blocks
+ *      containing a range of the data with *bshuf_decompress_range*. The
+ *      blocks are unchanged. Default is 0, without table.
+ *  Zstd dictionary (option slot 4) : integer (optional)
+ *      ID of a Zstd dictionary registered with *bshuf_register_zstd_dict*,
+ *      used to compress each block with Zstd compression. The dictionary is
+ *      not stored in the chunks: it must be registered before reading or
+ *      writing the data. The compression level is used to digest it.
+ *      Default is 0, without dictionary.
+ *
+ *      Larger blocks also help Zstd compression: the block size (option
+ *      slot 0) is stored in each chunk and is not limited to the default.
+ *  Truncated bit planes (option slot 5) : integer (optional)
+ *      Number of least significant bit planes set to zero before
+ *      bitshuffling, for lossy compression of data whose low bits are noise.
+ *      Requires little-endian integers or floats of up to 8 bytes, and at
+ *      most the number of mantissa bits for floats, so that their sign and
+ *      exponent are kept. The data is modified before compression, so it is
+ *      not compatible with a checksum filter applied before this one.
+ *      Default is 0, lossless.
+ *
+ * Chunks which are not a whole number of elements, e.g., when the filter
+ * follows the Fletcher32 filter, have their trailing bytes stored as is at
+ * the end of the filtered chunk.
  *
  */
 
@@ -47,6 +81,9 @@ extern "C" {
 #define BSHUF_H5_COMPRESS_ZSTD 3
 
 
+#define BSHUF_H5_FORMAT_BLOCK_OFFSETS 1
+
+
 extern H5Z_class_t bshuf_H5Filter[1];
 
 
@@ -60,6 +97,63 @@ extern H5Z_class_t bshuf_H5Filter[1];
  */
 int bshuf_register_h5filter(void);
 
+
+/* ---- bshuf_register_zstd_dict ----
+ *
+ * Register a Zstd dictionary for use by the bitshuffle HDF5 filter in this
+ * process. The dictionary is copied and kept until
+ * *bshuf_release_zstd_dicts* is called.
+ * Registering a dictionary more than once has no effect.
+ *
+ * Parameters
+ * ----------
+ *  dict : Zstd dictionary, as trained by zstd (with a dictionary ID)
+ *  dict_size : size of the dictionary in bytes
+ *
+ * Returns
+ * -------
+ *  ID of the dictionary to use as Zstd dictionary filter option, negative
+ *  error-code if failed.
+ *
+ */
+int64_t bshuf_register_zstd_dict(const void* dict, const size_t dict_size);
+
+
+/* ---- bshuf_release_zstd_dicts ----
+ *
+ * Free all the Zstd dictionaries registered with *bshuf_register_zstd_dict*.
+ * Must not be called while the filter is in use. The plugin calls it when
+ * it is unloaded.
+ *
+ */
+void bshuf_release_zstd_dicts(void);
+
+
+/* ---- bshuf_decompress_range ----
+ *
+ * Decompress part of a chunk compressed by the bitshuffle HDF5 filter with
+ * LZ4 or Zstd compression, only decompressing the blocks containing the
+ * bytes [*start*, *stop*) of the uncompressed chunk.
+ *
+ * Parameters
+ * ----------
+ *  chunk : compressed chunk, as returned by H5Dread_chunk
+ *  chunk_size : size of the compressed chunk in bytes
+ *  cd_nelmts : number of filter options of the dataset
+ *  cd_values : filter options of the dataset
+ *  start : offset of the first byte to decompress
+ *  stop : offset following the last byte to decompress
+ *  out : output buffer, must be of size stop - start bytes
+ *
+ * Returns
+ * -------
+ *  number of bytes written in *out*, negative error-code if failed.
+ *
+ */
+int64_t bshuf_decompress_range(const void* chunk, const size_t chunk_size,
+        const size_t cd_nelmts, const unsigned int cd_values[],
+        const size_t start, const size_t stop, void* out);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -17,3 +17,21 @@
 H5PL_type_t H5PLget_plugin_type(void) {return H5PL_TYPE_FILTER;}
 const void* H5PLget_plugin_info(void) {return bshuf_H5Filter;}
 
+
+
+/* Free the registered Zstd dictionaries when the plugin is unloaded. */
+#if defined(_WIN32)
+#include <windows.h>
+
+BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
+    (void)hinstDLL;
+    /* On process termination (lpvReserved != NULL), leave it to the system. */
+    if (fdwReason == DLL_PROCESS_DETACH && lpvReserved == NULL) {
+        bshuf_release_zstd_dicts();
+    }
+    return TRUE;
+}
+#elif defined(__GNUC__)
+__attribute__((destructor))
+static void bshuf_plugin_unload(void) { bshuf_release_zstd_dicts(); }
+#endif
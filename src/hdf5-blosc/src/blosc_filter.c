@@ -18,6 +18,12 @@
 #include "hdf5.h"
 #include "blosc_filter.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #if defined(__GNUC__)
 #define PUSH_ERR(func, minor, str, ...) H5Epush(H5E_DEFAULT, __FILE__, func, __LINE__, H5E_ERR_CLS, H5E_PLINE, minor, str, ##__VA_ARGS__)
 #elif defined(_MSC_VER)
@@ -38,6 +44,136 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
 herr_t blosc_set_local(hid_t dcpl, hid_t type, hid_t space);
 
 
+/* Pool of buffers recycled across filter calls.
+ *
+ * Buffers given to the filter by HDF5 are released with free() once
+ * replaced, so instead of freeing them, they are kept here to be used as
+ * output buffers of later calls, avoiding a fresh chunk-sized allocation
+ * (and its page faults) for each chunk.  The pool is shared by all threads
+ * and holds a few buffers, up to a total size: the oldest buffers are freed
+ * to make room for new ones.
+ */
+#define BUFFER_POOL_SIZE 4
+#define BUFFER_POOL_MAX_BYTES ((size_t) 256 * 1024 * 1024)
+
+typedef struct {
+  void *ptr;
+  size_t size;
+} pooled_buffer_t;
+
+static pooled_buffer_t buffer_pool[BUFFER_POOL_SIZE];
+static int buffer_pool_len = 0;
+static size_t buffer_pool_bytes = 0;
+
+#if defined(_WIN32)
+static SRWLOCK buffer_pool_lock = SRWLOCK_INIT;
+#define LOCK_BUFFER_POOL() AcquireSRWLockExclusive(&buffer_pool_lock)
+#define UNLOCK_BUFFER_POOL() ReleaseSRWLockExclusive(&buffer_pool_lock)
+#else
+static pthread_mutex_t buffer_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_BUFFER_POOL() pthread_mutex_lock(&buffer_pool_lock)
+#define UNLOCK_BUFFER_POOL() pthread_mutex_unlock(&buffer_pool_lock)
+#endif
+
+/* Take a buffer of at least size bytes (and not much more) from the pool
+ * or allocate one.  Its actual size is stored in capacity. */
+static void *acquire_buffer(size_t size, size_t *capacity) {
+  void *ptr = NULL;
+  int best = -1;
+
+  LOCK_BUFFER_POOL();
+  for (int i = 0; i < buffer_pool_len; i++) {
+    size_t pooled_size = buffer_pool[i].size;
+    if (pooled_size >= size && pooled_size / 2 <= size
+        && (best < 0 || pooled_size < buffer_pool[best].size)) {
+      best = i;
+    }
+  }
+  if (best >= 0) {
+    ptr = buffer_pool[best].ptr;
+    *capacity = buffer_pool[best].size;
+    buffer_pool_bytes -= buffer_pool[best].size;
+    /* Keep the remaining buffers from the oldest to the newest */
+    memmove(&buffer_pool[best], &buffer_pool[best + 1],
+            (buffer_pool_len - best - 1) * sizeof(pooled_buffer_t));
+    buffer_pool_len--;
+  }
+  UNLOCK_BUFFER_POOL();
+
+  if (ptr == NULL) {
+    ptr = malloc(size);
+    *capacity = size;
+  }
+  return ptr;
+}
+
+/* Give a buffer back to the pool, freeing the oldest ones if full. */
+static void release_buffer(void *ptr, size_t size) {
+  void *discarded[BUFFER_POOL_SIZE];
+  int ndiscarded = 0;
+
+  if (ptr == NULL) {
+    return;
+  }
+  if (size > BUFFER_POOL_MAX_BYTES) {
+    free(ptr);
+    return;
+  }
+
+  LOCK_BUFFER_POOL();
+  while (buffer_pool_len == BUFFER_POOL_SIZE
+         || buffer_pool_bytes + size > BUFFER_POOL_MAX_BYTES) {
+    discarded[ndiscarded++] = buffer_pool[0].ptr;
+    buffer_pool_bytes -= buffer_pool[0].size;
+    memmove(&buffer_pool[0], &buffer_pool[1], (buffer_pool_len - 1) * sizeof(pooled_buffer_t));
+    buffer_pool_len--;
+  }
+  buffer_pool[buffer_pool_len].ptr = ptr;
+  buffer_pool[buffer_pool_len].size = size;
+  buffer_pool_len++;
+  buffer_pool_bytes += size;
+  UNLOCK_BUFFER_POOL();
+
+  for (int i = 0; i < ndiscarded; i++) {
+    free(discarded[i]);
+  }
+}
+
+void release_blosc_buffers(void) {
+  LOCK_BUFFER_POOL();
+  for (int i = 0; i < buffer_pool_len; i++) {
+    free(buffer_pool[i].ptr);
+    buffer_pool[i].ptr = NULL;
+  }
+  buffer_pool_len = 0;
+  buffer_pool_bytes = 0;
+  UNLOCK_BUFFER_POOL();
+}
+
+
+/* The split mode is a global setting of the Blosc library, which
+ * blosc_compress_ctx() has no argument for.  It is kept to the library
+ * default, which compressions with the default split mode use concurrently
+ * under a shared lock.  Other split modes are set, used and reverted under
+ * an exclusive lock: those compressions are serialized, with each other and
+ * with the ones using the default split mode. */
+#if defined(BLOSC_FORWARD_COMPAT_SPLIT)
+#if defined(_WIN32)
+static SRWLOCK splitmode_lock = SRWLOCK_INIT;
+#define LOCK_SPLITMODE_SHARED() AcquireSRWLockShared(&splitmode_lock)
+#define UNLOCK_SPLITMODE_SHARED() ReleaseSRWLockShared(&splitmode_lock)
+#define LOCK_SPLITMODE_EXCLUSIVE() AcquireSRWLockExclusive(&splitmode_lock)
+#define UNLOCK_SPLITMODE_EXCLUSIVE() ReleaseSRWLockExclusive(&splitmode_lock)
+#else
+static pthread_rwlock_t splitmode_lock = PTHREAD_RWLOCK_INITIALIZER;
+#define LOCK_SPLITMODE_SHARED() pthread_rwlock_rdlock(&splitmode_lock)
+#define UNLOCK_SPLITMODE_SHARED() pthread_rwlock_unlock(&splitmode_lock)
+#define LOCK_SPLITMODE_EXCLUSIVE() pthread_rwlock_wrlock(&splitmode_lock)
+#define UNLOCK_SPLITMODE_EXCLUSIVE() pthread_rwlock_unlock(&splitmode_lock)
+#endif
+#endif
+
+
 /* Register the filter, passing on the HDF5 return value */
 int register_blosc(char **version, char **date){
 
@@ -72,6 +208,19 @@ int register_blosc(char **version, char **date){
     2. Compute the type size in bytes and store it in slot 2.
 
     3. Compute the chunk size in bytes and store it in slot 3.
+
+    Optional slots set by the user are:
+
+    - 4: compression level
+    - 5: shuffle method (BLOSC_NOSHUFFLE, BLOSC_SHUFFLE, BLOSC_BITSHUFFLE)
+    - 6: compressor code
+    - 7: number of threads (0 for the process-wide default)
+    - 8: block size in bytes (0 for automatic)
+    - 9: split mode (BLOSC_ALWAYS_SPLIT, BLOSC_NEVER_SPLIT, BLOSC_AUTO_SPLIT,
+         BLOSC_FORWARD_COMPAT_SPLIT or 0 for the default, which is
+         BLOSC_FORWARD_COMPAT_SPLIT)
+
+    Block size and split mode are only used for compression.
 */
 herr_t blosc_set_local(hid_t dcpl, hid_t type, hid_t space) {
 
@@ -83,8 +232,8 @@ herr_t blosc_set_local(hid_t dcpl, hid_t type, hid_t space) {
   unsigned int bufsize;
   hsize_t chunkdims[32];
   unsigned int flags;
-  size_t nelements = 8;
-  unsigned int values[] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t nelements = 10;
+  unsigned int values[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
   hid_t super_type;
   H5T_class_t classt;
 
@@ -151,9 +300,14 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
   int status = 0;                /* Return code from Blosc routines */
   size_t typesize;
   size_t outbuf_size;
+  size_t outbuf_capacity = 0;    /* Allocated size of outbuf */
   int clevel = 5;                /* Compression level default */
   int doshuffle = 1;             /* Shuffle default */
   int compcode;                  /* Blosc compressor */
+  int nthreads = 0;              /* Process-wide default */
+  size_t blocksize = 0;          /* Automatic block size */
+  int splitmode = 0;             /* Library default split mode */
+  const char* envvar;
   int code;
   const char* compname = "blosclz";    /* The compressor by default */
   const char* complist;
@@ -191,6 +345,41 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
     }
   }
 
+  if (cd_nelmts >= 8) {
+    nthreads = cd_values[7];     /* The number of threads */
+  }
+  /* The BLOSC_NTHREADS environment variable takes precedence,
+     as with the non-context Blosc API */
+  envvar = getenv("BLOSC_NTHREADS");
+  if (envvar != NULL && atoi(envvar) > 0) {
+    nthreads = atoi(envvar);
+  }
+  if (nthreads <= 0) {
+    nthreads = blosc_get_nthreads();
+  }
+  if (nthreads > BLOSC_MAX_THREADS) {
+    nthreads = BLOSC_MAX_THREADS;
+  }
+
+  if (cd_nelmts >= 9) {
+    blocksize = cd_values[8];    /* The block size */
+  }
+  if (cd_nelmts >= 10) {
+    splitmode = cd_values[9];    /* The split mode */
+#if defined(BLOSC_FORWARD_COMPAT_SPLIT)
+    if (splitmode < 0 || splitmode > BLOSC_FORWARD_COMPAT_SPLIT) {
+      PUSH_ERR("blosc_filter", H5E_CALLBACK, "Unsupported Blosc split mode: %d", splitmode);
+      goto failed;
+    }
+#else
+    if (splitmode != 0) {
+      PUSH_ERR("blosc_filter", H5E_CALLBACK,
+               "this Blosc library version does not support split modes.  Please update to >= 1.14");
+      goto failed;
+    }
+#endif
+  }
+
   /* We're compressing */
   if (!(flags & H5Z_FLAG_REVERSE)) {
 
@@ -207,7 +396,7 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
     nbytes, outbuf_size);
 #endif
 
-    outbuf = malloc(outbuf_size);
+    outbuf = acquire_buffer(outbuf_size, &outbuf_capacity);
 
     if (outbuf == NULL) {
       PUSH_ERR("blosc_filter", H5E_CALLBACK,
@@ -215,9 +404,25 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
       goto failed;
     }
 
-    blosc_set_compressor(compname);
-    status = blosc_compress(clevel, doshuffle, typesize, nbytes,
-                            *buf, outbuf, nbytes);
+#if defined(BLOSC_FORWARD_COMPAT_SPLIT)
+    if (splitmode != 0 && splitmode != BLOSC_FORWARD_COMPAT_SPLIT) {
+      LOCK_SPLITMODE_EXCLUSIVE();
+      blosc_set_splitmode(splitmode);
+      status = blosc_compress_ctx(clevel, doshuffle, typesize, nbytes,
+                                  *buf, outbuf, nbytes, compname, blocksize, nthreads);
+      blosc_set_splitmode(BLOSC_FORWARD_COMPAT_SPLIT);
+      UNLOCK_SPLITMODE_EXCLUSIVE();
+    } else {
+      /* Library default split mode, no need to set it */
+      LOCK_SPLITMODE_SHARED();
+      status = blosc_compress_ctx(clevel, doshuffle, typesize, nbytes,
+                                  *buf, outbuf, nbytes, compname, blocksize, nthreads);
+      UNLOCK_SPLITMODE_SHARED();
+    }
+#else
+    status = blosc_compress_ctx(clevel, doshuffle, typesize, nbytes,
+                                *buf, outbuf, nbytes, compname, blocksize, nthreads);
+#endif
     if (status < 0) {
       PUSH_ERR("blosc_filter", H5E_CALLBACK, "Blosc compression error");
       goto failed;
@@ -226,9 +431,7 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
     /* We're decompressing */
   } else {
     /* declare dummy variables */
-    size_t cbytes, blocksize;
-
-    free(outbuf);
+    size_t cbytes, cblocksize;
 
     /* Extract the exact outbuf_size from the buffer header.
      *
@@ -237,20 +440,47 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
      * cases since other filters in the pipeline can modify the buffere
      *  size.
      */
-    blosc_cbuffer_sizes(*buf, &outbuf_size, &cbytes, &blocksize);
+    if (nbytes < BLOSC_MIN_HEADER_LENGTH) {
+      PUSH_ERR("blosc_filter", H5E_CALLBACK, "Blosc buffer too small for header");
+      goto failed;
+    }
+    blosc_cbuffer_sizes(*buf, &outbuf_size, &cbytes, &cblocksize);
+    if (cbytes > nbytes) {
+      PUSH_ERR("blosc_filter", H5E_CALLBACK, "Blosc compressed size exceeds buffer size");
+      goto failed;
+    }
 
 #ifdef BLOSC_DEBUG
     fprintf(stderr, "Blosc: Decompress %zd chunk w/buffer %zd\n", nbytes, outbuf_size);
 #endif
 
-    outbuf = malloc(outbuf_size);
+    if (*buf_size >= outbuf_size) {
+      /* The buffer is large enough to hold decompressed data: only copy
+         compressed data aside (buffers cannot overlap) and decompress
+         into it. */
+      void* cbuf = acquire_buffer(cbytes, &outbuf_capacity);
+      if (cbuf == NULL) {
+        PUSH_ERR("blosc_filter", H5E_CALLBACK, "Can't allocate decompression buffer");
+        goto failed;
+      }
+      memcpy(cbuf, *buf, cbytes);
+      status = blosc_decompress_ctx(cbuf, *buf, outbuf_size, nthreads);
+      release_buffer(cbuf, outbuf_capacity);
+      if (status <= 0) {    /* decompression failed */
+        PUSH_ERR("blosc_filter", H5E_CALLBACK, "Blosc decompression error");
+        goto failed;
+      }
+      return status;  /* Size of decompressed data */
+    }
+
+    outbuf = acquire_buffer(outbuf_size, &outbuf_capacity);
 
     if (outbuf == NULL) {
       PUSH_ERR("blosc_filter", H5E_CALLBACK, "Can't allocate decompression buffer");
       goto failed;
     }
 
-    status = blosc_decompress(*buf, outbuf, outbuf_size);
+    status = blosc_decompress_ctx(*buf, outbuf, outbuf_size, nthreads);
     if (status <= 0) {    /* decompression failed */
       PUSH_ERR("blosc_filter", H5E_CALLBACK, "Blosc decompression error");
       goto failed;
@@ -259,14 +489,14 @@ size_t blosc_filter(unsigned flags, size_t cd_nelmts,
   } /* compressing vs decompressing */
 
   if (status != 0) {
-    free(*buf);
+    release_buffer(*buf, *buf_size);
     *buf = outbuf;
-    *buf_size = outbuf_size;
+    *buf_size = outbuf_capacity;
     return status;  /* Size of compressed/decompressed data */
   }
 
   failed:
-  free(outbuf);
+  release_buffer(outbuf, outbuf_capacity);
   return 0;
 
 } /* End filter function */
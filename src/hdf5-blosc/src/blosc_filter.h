@@ -20,6 +20,13 @@ __declspec(dllexport)
 #endif	/* defined(_MSC_VER) */
 int register_blosc(char **version, char **date);
 
+/* Releases the buffers kept for reuse across filter calls.
+ * To call when the filter is no longer used, e.g., when unloading it. */
+#if defined(_MSC_VER)
+__declspec(dllexport)
+#endif	/* defined(_MSC_VER) */
+void release_blosc_buffers(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -46,3 +46,21 @@ H5PL_type_t H5PLget_plugin_type(void) { return H5PL_TYPE_FILTER; }
 
 
 const void* H5PLget_plugin_info(void) { return blosc_H5Filter; }
+
+
+/* Free the buffers kept by the filter when the plugin is unloaded. */
+#if defined(_WIN32)
+#include <windows.h>
+
+BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
+  (void)hinstDLL;
+  /* On process termination (lpvReserved != NULL), threads are gone already. */
+  if (fdwReason == DLL_PROCESS_DETACH && lpvReserved == NULL) {
+    release_blosc_buffers();
+  }
+  return TRUE;
+}
+#elif defined(__GNUC__)
+__attribute__((destructor))
+static void blosc_plugin_unload(void) { release_blosc_buffers(); }
+#endif
@@ -40,7 +40,11 @@ from ._filters import SZ_ID, SZ  # noqa
 from ._filters import SZ3_ID, SZ3  # noqa
 from ._filters import SPERR_ID, Sperr  # noqa
 
-from ._utils import get_config, get_filters, PLUGIN_PATH, register  # noqa
+from ._utils import get_config, get_filters, PLUGIN_PATH, register, set_nthreads  # noqa
+from ._utils import get_simd  # noqa
+from ._utils import read_blosc2_slice  # noqa
+from ._utils import read_bitshuffle_slice  # noqa
+from ._utils import register_bitshuffle_dictionary, store_bitshuffle_dictionary  # noqa
 
 # Backward compatibility
 PLUGINS_PATH = PLUGIN_PATH
@@ -88,9 +88,37 @@ class Bitshuffle(h5py.filters.FilterRefBase):
         Default: 0 (for about 8 kilobytes per block).
     :param str cname:
         `lz4` (default), `none`, `zstd`
-    :param int clevel: Compression level, used only for `zstd` compression.
-        Can be negative, and must be below or equal to 22 (maximum compression).
+    :param int clevel: Compression level, used only for `lz4` and `zstd` compression.
+        For `zstd`, it can be negative, and must be below or equal to 22 (maximum compression).
         Default: 3.
+        For `lz4`, 1 to 12 (maximum compression) uses LZ4HC which is slower to compress,
+        and a negative value down to -65537 uses faster compression
+        with an acceleration factor of `-clevel`.
+        Default: 0, LZ4 default compression.
+        Decompression speed does not depend on it.
+        Previous versions ignored `clevel` for `lz4`, so a positive value now slows down compression.
+    :param bool block_offsets:
+        Whether to store a table of block offsets in each chunk (default: False).
+        It allows to decompress part of a chunk with :func:`read_bitshuffle_slice`
+        without scanning the blocks.
+        Used only for `lz4` and `zstd` compression.
+        Older versions of the filter cannot read datasets written with this option.
+    :param h5py.Dataset dictionary:
+        Zstd dictionary trained on similar data, used only for `zstd` compression.
+        Blocks compress better with a dictionary, and larger `nelems` also help.
+        The filter only stores the ID of the dictionary in the dataset,
+        so the dictionary must be stored in a file with :func:`store_bitshuffle_dictionary`
+        and registered with :func:`register_bitshuffle_dictionary` before reading.
+    :param int truncate_planes:
+        Number of least significant bit planes to set to zero before compression
+        (default: 0, lossless).
+        This is a fast lossy mode for data whose low bits are noise,
+        e.g., photon-counting detectors.
+        Values are truncated towards minus infinity for integers, and towards zero for floats.
+        At most the number of bits of integers and of the mantissa of floats
+        (i.e., 23 for float32 and 52 for float64), which the filter checks
+        when the dataset is created.
+        It requires little-endian data and is not compatible with a checksum computed before.
     """
     filter_name = "bshuf"
     filter_id = BSHUF_ID
@@ -101,10 +129,20 @@ class Bitshuffle(h5py.filters.FilterRefBase):
         'zstd': 3,
     }
 
-    def __init__(self, nelems=0, cname=None, clevel=3, lz4=None):
+    __BLOCK_OFFSETS_FORMAT = 1
+
+    def __init__(
+        self,
+        nelems=0,
+        cname=None,
+        clevel=None,
+        lz4=None,
+        block_offsets=False,
+        dictionary=None,
+        truncate_planes=0,
+    ):
         nelems = int(nelems)
         assert nelems % 8 == 0
-        assert clevel <= 22
 
         if lz4 is not None:
             if cname is not None and lz4 is not False:
@@ -126,9 +164,41 @@ class Bitshuffle(h5py.filters.FilterRefBase):
             raise ValueError(f"Unsupported compression: {cname}")
 
         if cname == 'zstd':
-            self.filter_options = (nelems, self.__COMPRESSIONS[cname], clevel)
+            clevel = 3 if clevel is None else int(clevel)
+            assert clevel <= 22
+        elif cname == 'lz4':
+            clevel = 0 if clevel is None else int(clevel)
+            assert -65537 <= clevel <= 12
         else:
-            self.filter_options = (nelems, self.__COMPRESSIONS[cname])
+            clevel = 0
+
+        dictionary_id = 0
+        if dictionary is not None:
+            if cname != 'zstd':
+                raise ValueError("dictionary is only supported with zstd compression")
+            if not isinstance(dictionary, h5py.Dataset):
+                raise ValueError(
+                    "dictionary must be a dataset, "
+                    "use hdf5plugin.store_bitshuffle_dictionary to store it in the file")
+            from ._utils import register_bitshuffle_dictionary
+            dictionary_id = register_bitshuffle_dictionary(dictionary)
+
+        truncate_planes = int(truncate_planes)
+        assert 0 <= truncate_planes <= 64  # Checked against the dtype by the filter
+
+        options = (
+            nelems,
+            self.__COMPRESSIONS[cname],
+            struct.unpack('I', struct.pack('i', clevel))[0],  # Negative levels as unsigned int
+            self.__BLOCK_OFFSETS_FORMAT if block_offsets and cname != 'none' else 0,
+            dictionary_id,
+            truncate_planes,
+        )
+        # Strip trailing default options, zstd always gets its level
+        nelmts = len(options)
+        while nelmts > (3 if cname == 'zstd' else 2) and options[nelmts - 1] == 0:
+            nelmts -= 1
+        self.filter_options = options[:nelmts]
 
 
 class Blosc(h5py.filters.FilterRefBase):
@@ -154,6 +224,27 @@ class Blosc(h5py.filters.FilterRefBase):
         - Blosc.NOSHUFFLE (0): No shuffle
         - Blosc.SHUFFLE (1): byte-wise shuffle (default)
         - Blosc.BITSHUFFLE (2): bit-wise shuffle
+    :param int nthreads:
+        Number of threads to use for compression and decompression of this dataset.
+        Default: 0 (use the process-wide default, see :func:`hdf5plugin.set_nthreads`).
+        The ``BLOSC_NTHREADS`` environment variable takes precedence over this option.
+    :param int blocksize:
+        Size in bytes of the blocks into which chunks are split for compression.
+        Default: 0 (automatic, depending on ``cname`` and ``clevel``).
+    :param int splitmode: Whether to split blocks into streams of bytes
+        of the same significance before compression. One of:
+
+        - 0: Use Blosc.FORWARD_COMPAT_SPLIT (default)
+        - Blosc.ALWAYS_SPLIT (1): Always split
+        - Blosc.NEVER_SPLIT (2): Never split
+        - Blosc.AUTO_SPLIT (3): Let Blosc decide based on heuristics
+        - Blosc.FORWARD_COMPAT_SPLIT (4): Split as previous versions of Blosc did
+
+        The split mode is a process-wide setting of the Blosc library:
+        chunks compressed with another split mode than the default
+        are compressed one at a time in the process.
+
+    Older versions of the filter ignore ``blocksize`` and ``splitmode``.
     """
 
     NOSHUFFLE = 0
@@ -165,6 +256,18 @@ class Blosc(h5py.filters.FilterRefBase):
     BITSHUFFLE = 2
     """Flag to enable bit-wise shuffle pre-compression filter"""
 
+    ALWAYS_SPLIT = 1
+    """Flag to always split blocks before compression"""
+
+    NEVER_SPLIT = 2
+    """Flag to never split blocks before compression"""
+
+    AUTO_SPLIT = 3
+    """Flag to split blocks before compression depending on heuristics"""
+
+    FORWARD_COMPAT_SPLIT = 4
+    """Flag to split blocks before compression in a forward compatible way"""
+
     filter_name = "blosc"
     filter_id = BLOSC_ID
 
@@ -177,13 +280,38 @@ class Blosc(h5py.filters.FilterRefBase):
         'zstd': 5,
     }
 
-    def __init__(self, cname='lz4', clevel=5, shuffle=SHUFFLE):
+    def __init__(
+        self,
+        cname='lz4',
+        clevel=5,
+        shuffle=SHUFFLE,
+        nthreads=0,
+        blocksize=0,
+        splitmode=0,
+    ):
         compression = self.__COMPRESSIONS[cname]
         clevel = int(clevel)
         assert 0 <= clevel <= 9
         assert shuffle in (self.NOSHUFFLE, self.SHUFFLE, self.BITSHUFFLE)
+        nthreads = int(nthreads)
+        assert 0 <= nthreads <= 256
+        blocksize = int(blocksize)
+        assert 0 <= blocksize < 2**31
+        assert splitmode in (
+            0,
+            self.ALWAYS_SPLIT,
+            self.NEVER_SPLIT,
+            self.AUTO_SPLIT,
+            self.FORWARD_COMPAT_SPLIT,
+        )
         self.filter_options = (0, 0, 0, 0, clevel, shuffle, compression)
 
+        # Only store optional values up to the last one set
+        options = [nthreads, blocksize, splitmode]
+        while options and options[-1] == 0:
+            options.pop()
+        self.filter_options += tuple(options)
+
 
 class Blosc2(h5py.filters.FilterRefBase):
     """``h5py.Group.create_dataset``'s compression arguments for using blosc2 filter.
@@ -198,17 +326,61 @@ class Blosc2(h5py.filters.FilterRefBase):
         f.close()
 
     :param str cname:
-        `blosclz` (default), `lz4`, `lz4hc`, `zlib`, `zstd`
+        `blosclz` (default), `lz4`, `lz4hc`, `zlib`, `zstd`, or one of the following
+        codecs working on multidimensional (B2ND) chunks, which require datasets
+        of at least 2 dimensions:
+
+        - `ndlz`: Lossless compression of 2D datasets of 1-byte items (e.g., 8-bit images).
+          ``codec_meta`` is the cell size: 4 (default) or 8.
+        - `zfp_acc`: ZFP lossy compression of float32/float64 datasets in fixed-accuracy mode.
+          ``codec_meta`` is the exponent of the absolute error tolerance (from -128 to 127),
+          e.g. -3 for 1e-3.
+        - `zfp_prec`: ZFP lossy compression of float32/float64 datasets in fixed-precision mode.
+          ``codec_meta`` is the number of bit planes to keep.
+        - `zfp_rate`: ZFP lossy compression of float32/float64 datasets in fixed-rate mode.
+          ``codec_meta`` is the size of the compressed data as a percentage (1 to 100)
+          of the uncompressed data size.
     :param int clevel:
         Compression level from 0 (no compression) to 9 (maximum compression).
         Default: 5.
-    :param int filters: One of:
+    :param int codec_meta:
+        Parameter of the codec (see ``cname``), from -128 to 255.
+        Default: 0, which means 4 for `ndlz`.
+        Older versions of the filter do not support this option.
+    :param filters: One of:
 
         - Blosc2.NOFILTER (0): No pre-compression filter
         - Blosc2.SHUFFLE (1): Byte-wise shuffle (default)
         - Blosc2.BITSHUFFLE (2): Bit-wise shuffle
         - Blosc2.DELTA (3): Stores diff'ed blocks
         - Blosc2.TRUNC_PREC (4): Zeroes the least significant bits of the mantissa
+        - Blosc2.BYTEDELTA (35): Stores diff'ed bytes of each byte stream (to use after SHUFFLE)
+        - Blosc2.INT_TRUNC (36): Zeroes the least significant bits of integers
+        - Blosc2.NDCELL (32): Groups items of multidimensional (B2ND) chunks by cells
+        - Blosc2.NDMEAN (33): Replaces items of multidimensional (B2ND) chunks
+          by their mean over cells (lossy)
+
+        or a pipeline of up to 6 filters applied in order, each given either as
+        a filter code or as a ``(filter, meta)`` tuple, with meta a byte
+        (from -128 to 255) passed to the filter, for instance
+        ``[Blosc2.SHUFFLE, (Blosc2.BYTEDELTA, 4)]`` or ``[(Blosc2.TRUNC_PREC, 10), Blosc2.SHUFFLE]``.
+        Older versions of the filter do not support pipelines.
+    :type filters: int or List[Union[int,Tuple[int,int]]]
+    :param bool raw_chunk:
+        Whether to store chunks as bare Blosc2 chunks rather than Blosc2 super-chunk frames (default).
+        This saves a copy of compressed data when writing and reading chunks,
+        but disables the multidimensional (B2ND) storage of chunks
+        and Blosc2 plugins that rely on super-chunk metadata:
+        multidimensional codecs, NDCELL and NDMEAN filters and ``access`` are not supported.
+        Older versions of the filter cannot read datasets written with this option.
+    :param str access:
+        Expected access pattern, used to choose the shape of the blocks
+        of multidimensional (B2ND) chunks. One of:
+
+        - None (default): Blocks growing from the innermost dimension, for contiguous reads.
+        - `'slice_axis<N>'`, e.g. `'slice_axis0'`: Blocks of thickness 1 along axis N,
+          for reading slices at given indices along axis N (e.g. ``dataset[i]`` for axis 0)
+          without decompressing data from other indices.
     """
 
     NOFILTER = 0
@@ -226,6 +398,30 @@ class Blosc2(h5py.filters.FilterRefBase):
     TRUNC_PREC = 4
     """Flag to zeroes the least significant bits of the mantissa of float32 and float64 types"""
 
+    BYTEDELTA = 35
+    """Flag to store bytes diff'ed with respect to the previous byte of the same stream
+
+    Its meta is the type size (0 for the dataset type size), it is meant to follow SHUFFLE.
+    """
+
+    INT_TRUNC = 36
+    """Flag to zeroes the least significant bits of integer types
+
+    Its meta is the number of bits to keep (if positive) or to zero (if negative).
+    """
+
+    NDCELL = 32
+    """Flag to group items of multidimensional chunks by cells
+
+    Its meta is the cell size along each dimension.
+    """
+
+    NDMEAN = 33
+    """Flag to replace items of multidimensional float chunks by their mean over cells
+
+    Its meta is the cell size along each dimension.
+    """
+
     filter_id = BLOSC2_ID
     filter_name = "blosc2"
 
@@ -235,15 +431,104 @@ class Blosc2(h5py.filters.FilterRefBase):
         'lz4hc': 2,
         'zlib': 4,
         'zstd': 5,
+        'ndlz': 32,
+        'zfp_acc': 33,
+        'zfp_prec': 34,
+        'zfp_rate': 35,
     }
 
-    def __init__(self, cname='blosclz', clevel=5, filters=SHUFFLE):
+    __DEFAULT_CODEC_META = {'ndlz': 4}
+
+    __ND_CODECS = 'ndlz', 'zfp_acc', 'zfp_prec', 'zfp_rate'
+    """Codecs working on multidimensional (B2ND) chunks"""
+
+    __FILTERS = NOFILTER, SHUFFLE, BITSHUFFLE, DELTA, TRUNC_PREC, BYTEDELTA, INT_TRUNC, NDCELL, NDMEAN
+
+    __ND_FILTERS = NDCELL, NDMEAN
+    """Filters working on multidimensional (B2ND) chunks"""
+
+    __MAX_FILTERS = 6
+    """Maximum number of filters in a pipeline"""
+
+    __MAX_DIMS = 8
+    """Maximum rank of multidimensional (B2ND) chunks"""
+
+    __EXT_OPTIONS_OFFSET = 16
+    """Index of the first extended filter option"""
+
+    def __init__(
+        self,
+        cname='blosclz',
+        clevel=5,
+        filters=SHUFFLE,
+        raw_chunk=False,
+        codec_meta=0,
+        access=None,
+    ):
         compression = self.__COMPRESSIONS[cname]
         clevel = int(clevel)
         assert 0 <= clevel <= 9
-        assert filters in (self.NOFILTER, self.SHUFFLE, self.BITSHUFFLE, self.DELTA, self.TRUNC_PREC)
+        codec_meta = int(codec_meta)
+        if codec_meta != 0 and cname not in self.__ND_CODECS:
+            raise ValueError(f"codec_meta is not supported by {cname} codec")
+        codec_meta = codec_meta or self.__DEFAULT_CODEC_META.get(cname, 0)
+        assert -128 <= codec_meta <= 255
+        if cname == 'ndlz' and codec_meta not in (4, 8):
+            raise ValueError(f"Unsupported ndlz cell size: {codec_meta}")
+        if cname == 'zfp_rate' and not 1 <= codec_meta <= 100:
+            raise ValueError(f"Unsupported zfp_rate rate: {codec_meta}")
+        if isinstance(filters, (tuple, list)):
+            pipeline = self.__get_pipeline_options(filters)
+            filter_codes = [option & 0xff for option in pipeline]
+            filters = pipeline[-1] & 0xff  # Informative only
+        else:
+            filters = int(filters)
+            assert filters in self.__FILTERS
+            filter_codes = [filters]
+            pipeline = ()
+        if raw_chunk:  # Raw chunks have no B2ND metalayers
+            if cname in self.__ND_CODECS:
+                raise ValueError(f"{cname} codec is not supported with raw_chunk")
+            if any(code in self.__ND_FILTERS for code in filter_codes):
+                raise ValueError("NDCELL and NDMEAN filters are not supported with raw_chunk")
+            if access is not None:
+                raise ValueError("access is not supported with raw_chunk")
+        if access is None:
+            access_option = 0
+        else:
+            assert access.startswith('slice_axis')
+            axis = int(access[len('slice_axis'):])
+            assert 0 <= axis < self.__MAX_DIMS
+            access_option = 1 + axis
         self.filter_options = (0, 0, 0, 0, clevel, filters, compression)
 
+        last_options = (codec_meta & 0xff, access_option)
+        if any(last_options) and not pipeline:
+            pipeline = self.__get_pipeline_options([filters])
+
+        # First extended option is reserved
+        ext_options = (0, 1 if raw_chunk else 0) + pipeline + last_options
+        while ext_options and ext_options[-1] == 0:
+            ext_options = ext_options[:-1]  # Same as missing options
+        if ext_options:
+            # Chunk rank and shape slots are filled by the filter
+            padding = (0,) * (self.__EXT_OPTIONS_OFFSET - len(self.filter_options))
+            self.filter_options += padding + ext_options
+
+    def __get_pipeline_options(self, filters):
+        """Returns the filter options encoding the given pipeline of filters"""
+        assert len(filters) <= self.__MAX_FILTERS
+        options = []
+        for filter_ in filters:
+            code, meta = filter_ if isinstance(filter_, (tuple, list)) else (filter_, 0)
+            code, meta = int(code), int(meta)
+            assert code in self.__FILTERS
+            assert -128 <= meta <= 255
+            options.append(code | ((meta & 0xff) << 8))
+        # Last filter of the pipeline on the last slot, as for a single filter
+        padding = [self.NOFILTER] * (self.__MAX_FILTERS - len(options))
+        return tuple(padding + options)
+
 
 class BZip2(h5py.filters.FilterRefBase):
     """``h5py.Group.create_dataset``'s compression arguments for using BZip2 filter.
@@ -304,15 +589,29 @@ class LZ4(h5py.filters.FilterRefBase):
     :param int nbytes:
         The number of bytes per block.
         It needs to be in the range of 0 < nbytes < 2113929216 (1,9GB).
-        Default: 0 (for 1GB per block).
+        Default: 0 (for 1MB per block).
+        Blocks are compressed and decompressed in parallel when built with OpenMP.
+    :param int clevel:
+        Compression level.
+        1 to 12 (maximum compression) uses LZ4HC which is slower to compress,
+        and a negative value down to -65537 uses faster compression
+        with an acceleration factor of `-clevel`.
+        Default: 0, LZ4 default compression.
+        Decompression does not depend on it.
     """
     filter_name = "lz4"
     filter_id = LZ4_ID
 
-    def __init__(self, nbytes=0):
+    def __init__(self, nbytes=0, clevel=0):
         nbytes = int(nbytes)
         assert 0 <= nbytes <= 0x7E000000
-        self.filter_options = (nbytes,)
+        clevel = int(clevel)
+        assert -65537 <= clevel <= 12
+        if clevel == 0:
+            self.filter_options = (nbytes,)
+        else:
+            # Option slot 1 is reserved for the number of threads
+            self.filter_options = (nbytes, 0, struct.unpack('I', struct.pack('i', clevel))[0])
 
 
 class Zfp(h5py.filters.FilterRefBase):
@@ -716,6 +1015,22 @@ class Zstd(h5py.filters.FilterRefBase):
 
     :param int clevel: Compression level from 1 (lowest compression) to 22 (maximum compression).
         Ultra compression extends from 20 through 22. Default: 3.
+    :param int nworkers:
+        Number of threads compressing each chunk (default: 0, in the calling thread).
+        Worth it for large chunks and high compression levels.
+        Creating the dataset fails if the filter is built without multithreading.
+    :param int job_size:
+        Size in bytes of the parts of a chunk compressed by each thread,
+        used only with `nworkers` (default: 0, automatic from the compression parameters).
+    :param bool long_distance_matching:
+        Whether to find matches further apart in large chunks (default: False).
+    :param int window_log:
+        Base 2 logarithm of the largest match distance, from 10 to 31 (30 on 32-bit platforms)
+        (default: 0, automatic from `clevel` and the chunk size).
+        This filter reads any window, but other Zstd decoders only accept values above 27
+        when their window limit is raised (e.g., ``ZSTD_d_windowLogMax``, ``zstd --long``).
+
+    Those options are only used for compression.
 
     .. code-block:: python
 
@@ -724,14 +1039,31 @@ class Zstd(h5py.filters.FilterRefBase):
             'zstd',
             data=numpy.arange(100),
             compression=hdf5plugin.Zstd(clevel=22))
+        f.create_dataset(
+            'zstd_multithreaded',
+            data=numpy.arange(100),
+            compression=hdf5plugin.Zstd(clevel=19, nworkers=8))
         f.close()
     """
     filter_name = "zstd"
     filter_id = ZSTD_ID
 
-    def __init__(self, clevel=3):
+    def __init__(self, clevel=3, nworkers=0, job_size=0, long_distance_matching=False, window_log=0):
         assert 1 <= clevel <= 22
-        self.filter_options = (clevel,)
+        nworkers = int(nworkers)
+        assert 0 <= nworkers <= 200
+        job_size = int(job_size)
+        assert 0 <= job_size < 2**31
+        window_log = int(window_log)
+        # ZSTD_WINDOWLOG_MAX depends on the size of pointers
+        assert window_log == 0 or 10 <= window_log <= (30 if struct.calcsize('P') == 4 else 31)
+
+        options = (clevel, nworkers, job_size, 1 if long_distance_matching else 0, window_log)
+        # Strip trailing default options
+        nelmts = len(options)
+        while nelmts > 1 and options[nelmts - 1] == 0:
+            nelmts -= 1
+        self.filter_options = options[:nelmts]
 
 
 FILTER_CLASSES = Bitshuffle, Blosc, Blosc2, BZip2, FciDecomp, LZ4, Sperr, SZ, SZ3, Zfp, Zstd
@@ -25,14 +25,16 @@
 
 import ctypes
 import glob
+import itertools
 import logging
 import os
 import sys
 import traceback
 from collections import namedtuple
+import numpy
 import h5py
 
-from ._filters import FILTER_CLASSES, FILTERS
+from ._filters import BLOSC2_ID, BSHUF_ID, FILTER_CLASSES, FILTERS
 from ._config import build_config
 
 
@@ -176,15 +178,317 @@ def register_filter(name):
     return True
 
 
+def set_nthreads(nthreads):
+    """Set the default number of threads used by filters registered by hdf5plugin.
+
+    This applies to the following filters: blosc, blosc2.
+    Blosc datasets with a number of threads set in their filter options use it instead.
+    The ``BLOSC_NTHREADS`` environment variable takes precedence over this setting.
+
+    :param int nthreads: Number of threads (at least 1)
+    :returns: The previous number of threads, None if no filter was configured
+    :rtype: Optional[int]
+    :raises ValueError: If nthreads is not a positive number
+    :raises RuntimeError: If the number of threads cannot be set
+    """
+    nthreads = int(nthreads)
+    if not 1 <= nthreads <= 2**15 - 1:
+        raise ValueError(f"Unsupported number of threads: {nthreads}")
+
+    previous = None
+
+    info = registered_filters.get("blosc")
+    if info is not None:
+        set_nthreads_func = info[1].blosc_set_nthreads
+        set_nthreads_func.argtypes = [ctypes.c_int]
+        set_nthreads_func.restype = ctypes.c_int
+        previous = set_nthreads_func(min(nthreads, 256))
+
+    info = registered_filters.get("blosc2")
+    if info is not None:
+        set_nthreads_func = info[1].blosc2_set_nthreads
+        set_nthreads_func.argtypes = [ctypes.c_int16]
+        set_nthreads_func.restype = ctypes.c_int16
+        previous = set_nthreads_func(nthreads)
+        if previous < 0:
+            raise RuntimeError(f"Cannot set blosc2 filter number of threads to {nthreads}")
+
+    return previous
+
+
+def _parse_selection(dataset, selection):
+    """Returns start, stop and indexed axes of a selection of indices and slices"""
+    if not isinstance(selection, tuple):
+        selection = (selection,)
+    if len(selection) > dataset.ndim:
+        raise ValueError(f"Too many indices for dataset of rank {dataset.ndim}")
+    selection += (slice(None),) * (dataset.ndim - len(selection))
+
+    start, stop, index_axes = [], [], []
+    for axis, (index, size) in enumerate(zip(selection, dataset.shape)):
+        if isinstance(index, slice):
+            begin, end, step = index.indices(size)
+            if step != 1:
+                raise ValueError(f"Unsupported slice step: {step}")
+            start.append(begin)
+            stop.append(max(begin, end))
+        else:
+            index = int(index)
+            if not -size <= index < size:
+                raise IndexError(f"Index {index} out of range for axis {axis}")
+            start.append(index % size)
+            stop.append(index % size + 1)
+            index_axes.append(axis)
+    return start, stop, index_axes
+
+
+def read_blosc2_slice(dataset, selection):
+    """Read a hyperslab of a dataset compressed with the blosc2 filter.
+
+    For chunks stored as multidimensional (B2ND) arrays, only the Blosc2 blocks
+    which intersect the hyperslab are decompressed, which is faster than reading
+    through HDF5 for small hyperslabs of large chunks.
+    Other chunks are read through HDF5.
+
+    .. code-block:: python
+
+        with h5py.File('test.h5', 'r') as f:
+            sinogram = hdf5plugin.read_blosc2_slice(f['volume'], (slice(None), 42, slice(None)))
+
+    :param h5py.Dataset dataset: Chunked dataset with the blosc2 filter as only filter
+    :param selection:
+        Indices and slices (with a step of 1) along each dimension of the dataset.
+        Missing trailing dimensions are fully selected.
+    :rtype: numpy.ndarray
+    :raises ValueError: If the selection is not supported
+    """
+    start, stop, index_axes = _parse_selection(dataset, selection)
+
+    info = registered_filters.get("blosc2")
+    plist = dataset.id.get_create_plist()
+    filter_ids = [plist.get_filter(i)[0] for i in range(plist.get_nfilters())]
+    if info is None or dataset.chunks is None or filter_ids != [BLOSC2_ID]:
+        data = dataset[tuple(slice(b, e) for b, e in zip(start, stop))]
+        return data.squeeze(axis=tuple(index_axes))
+
+    decompress_slice = info[1].decompress_b2nd_chunk_slice
+    decompress_slice.argtypes = [
+        ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int,
+        ctypes.POINTER(ctypes.c_int64), ctypes.POINTER(ctypes.c_int64),
+        ctypes.c_void_p, ctypes.c_size_t,
+    ]
+    decompress_slice.restype = ctypes.c_int64
+    int64_array_type = ctypes.c_int64 * dataset.ndim
+
+    data = numpy.empty([e - b for b, e in zip(start, stop)], dtype=dataset.dtype)
+    chunk_ranges = [
+        range(b // c, (e + c - 1) // c) for b, e, c in zip(start, stop, dataset.chunks)
+    ]
+    for chunk_index in itertools.product(*chunk_ranges):
+        offset = [i * c for i, c in zip(chunk_index, dataset.chunks)]
+        chunk_start = [max(b, o) - o for b, o in zip(start, offset)]
+        chunk_stop = [min(e, o + c) - o for e, o, c in zip(stop, offset, dataset.chunks)]
+        data_selection = tuple(
+            slice(o + cb - b, o + ce - b)
+            for o, cb, ce, b in zip(offset, chunk_start, chunk_stop, start)
+        )
+
+        buffer = numpy.empty([e - b for b, e in zip(chunk_start, chunk_stop)], dtype=dataset.dtype)
+        try:
+            filter_mask, chunk = dataset.id.read_direct_chunk(tuple(offset))
+        except (KeyError, OSError, ValueError):  # e.g., chunk not allocated
+            filter_mask, chunk = None, b""
+        if filter_mask != 0 or decompress_slice(
+            chunk, len(chunk), dataset.ndim,
+            int64_array_type(*chunk_start), int64_array_type(*chunk_stop),
+            buffer.ctypes.data, buffer.nbytes,
+        ) < 0:
+            # Not a B2ND chunk: read through HDF5
+            dataset_selection = tuple(
+                slice(o + cb, o + ce) for o, cb, ce in zip(offset, chunk_start, chunk_stop)
+            )
+            dataset.read_direct(buffer, source_sel=dataset_selection)
+        data[data_selection] = buffer
+
+    return data.squeeze(axis=tuple(index_axes))
+
+
+def read_bitshuffle_slice(dataset, selection):
+    """Read a hyperslab of a dataset compressed with the bitshuffle filter.
+
+    For chunks compressed with `lz4` or `zstd`, only the bitshuffle blocks
+    which contain the rows (i.e., along the first dimension of the chunk)
+    intersecting the hyperslab are decompressed.
+    Datasets written with ``block_offsets=True`` store the location of the blocks
+    in each chunk, so only the headers of the decompressed blocks are read.
+    For other datasets, the headers of all the blocks of a chunk are scanned
+    to locate them.
+    Other chunks are read through HDF5.
+
+    .. code-block:: python
+
+        with h5py.File('test.h5', 'r') as f:
+            frame = hdf5plugin.read_bitshuffle_slice(f['stack'], 42)
+
+    :param h5py.Dataset dataset: Chunked dataset with the bitshuffle filter as only filter
+    :param selection:
+        Indices and slices (with a step of 1) along each dimension of the dataset.
+        Missing trailing dimensions are fully selected.
+    :rtype: numpy.ndarray
+    :raises ValueError: If the selection is not supported
+    """
+    start, stop, index_axes = _parse_selection(dataset, selection)
+
+    info = registered_filters.get("bshuf")
+    plist = dataset.id.get_create_plist()
+    filter_ids = [plist.get_filter(i)[0] for i in range(plist.get_nfilters())]
+    if info is None or dataset.chunks is None or filter_ids != [BSHUF_ID]:
+        data = dataset[tuple(slice(b, e) for b, e in zip(start, stop))]
+        return data.squeeze(axis=tuple(index_axes))
+
+    decompress_range = info[1].bshuf_decompress_range
+    decompress_range.argtypes = [
+        ctypes.c_char_p, ctypes.c_size_t, ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_uint), ctypes.c_size_t, ctypes.c_size_t,
+        ctypes.c_void_p,
+    ]
+    decompress_range.restype = ctypes.c_int64
+    cd_values = plist.get_filter_by_id(BSHUF_ID)[1]
+    cd_values_array = (ctypes.c_uint * len(cd_values))(*cd_values)
+
+    row_shape = dataset.chunks[1:]
+    row_nbytes = int(numpy.prod(row_shape, dtype=numpy.int64)) * dataset.dtype.itemsize
+
+    data = numpy.empty([e - b for b, e in zip(start, stop)], dtype=dataset.dtype)
+    chunk_ranges = [
+        range(b // c, (e + c - 1) // c) for b, e, c in zip(start, stop, dataset.chunks)
+    ]
+    for chunk_index in itertools.product(*chunk_ranges):
+        offset = [i * c for i, c in zip(chunk_index, dataset.chunks)]
+        chunk_start = [max(b, o) - o for b, o in zip(start, offset)]
+        chunk_stop = [min(e, o + c) - o for e, o, c in zip(stop, offset, dataset.chunks)]
+        data_selection = tuple(
+            slice(o + cb - b, o + ce - b)
+            for o, cb, ce, b in zip(offset, chunk_start, chunk_stop, start)
+        )
+
+        # Decompress whole rows of the chunk, then select the other dimensions
+        rows = numpy.empty(
+            (chunk_stop[0] - chunk_start[0],) + row_shape, dtype=dataset.dtype)
+        try:
+            filter_mask, chunk = dataset.id.read_direct_chunk(tuple(offset))
+        except (KeyError, OSError, ValueError):  # e.g., chunk not allocated
+            filter_mask, chunk = None, b""
+        if filter_mask == 0 and decompress_range(
+            chunk, len(chunk), len(cd_values), cd_values_array,
+            chunk_start[0] * row_nbytes, chunk_stop[0] * row_nbytes,
+            rows.ctypes.data,
+        ) >= 0:
+            data[data_selection] = rows[
+                (slice(None),) + tuple(slice(b, e) for b, e in zip(chunk_start[1:], chunk_stop[1:]))
+            ]
+        else:
+            # Not compressed or not stored: read through HDF5
+            dataset_selection = tuple(
+                slice(o + cb, o + ce) for o, cb, ce in zip(offset, chunk_start, chunk_stop)
+            )
+            data[data_selection] = dataset[dataset_selection]
+
+    return data.squeeze(axis=tuple(index_axes))
+
+
+def store_bitshuffle_dictionary(group, name, dictionary):
+    """Store a Zstd dictionary for the bitshuffle filter as a dataset of uint8.
+
+    The bitshuffle filter only stores the ID of the dictionary in compressed datasets.
+    The returned dataset is the one to pass to :class:`Bitshuffle` to compress with it,
+    and to :func:`register_bitshuffle_dictionary` to read the compressed datasets.
+
+    .. code-block:: python
+
+        with h5py.File('test.h5', 'w') as f:
+            zstd_dictionary = hdf5plugin.store_bitshuffle_dictionary(f, 'zstd_dictionary', dictionary)
+            f.create_dataset(
+                'data',
+                data=data,
+                compression=hdf5plugin.Bitshuffle(cname='zstd', dictionary=zstd_dictionary))
+
+        with h5py.File('test.h5', 'r') as f:
+            hdf5plugin.register_bitshuffle_dictionary(f['zstd_dictionary'])
+            data = f['data'][()]
+
+    :param h5py.Group group: Group where to store the dictionary
+    :param str name: Name of the dataset to create
+    :param bytes dictionary: Zstd dictionary, as trained by zstd (e.g., ``zstd --train``)
+    :rtype: h5py.Dataset
+    """
+    return group.create_dataset(name, data=numpy.frombuffer(bytes(dictionary), dtype=numpy.uint8))
+
+
+def register_bitshuffle_dictionary(dictionary):
+    """Register a Zstd dictionary for the bitshuffle filter in the current process.
+
+    Bitshuffle compresses blocks of a few kilobytes, for which Zstd compresses
+    better with a dictionary trained on similar data
+    (e.g., with ``zstd --train``).
+    The dictionary is not stored in the compressed chunks: it must be stored in the file
+    with :func:`store_bitshuffle_dictionary` and registered before reading the data.
+    Other HDF5 readers cannot read those datasets.
+    A dictionary is loaded once per process, registering it again only returns its ID.
+
+    :param dictionary:
+        Zstd dictionary as h5py.Dataset (see :func:`store_bitshuffle_dictionary`),
+        bytes or numpy array
+    :returns: ID of the dictionary
+    :rtype: int
+    :raises RuntimeError: If the dictionary cannot be registered
+    """
+    if isinstance(dictionary, h5py.Dataset):
+        dictionary = dictionary[()]
+    if isinstance(dictionary, (numpy.ndarray, numpy.generic)):
+        dictionary = dictionary.tobytes()
+    dictionary = bytes(dictionary)
+
+    info = registered_filters.get("bshuf")
+    if info is None:
+        raise RuntimeError("Bitshuffle filter is not available")
+    register_func = info[1].bshuf_register_zstd_dict
+    register_func.argtypes = [ctypes.c_char_p, ctypes.c_size_t]
+    register_func.restype = ctypes.c_int64
+    dictionary_id = register_func(dictionary, len(dictionary))
+    if dictionary_id < 0:
+        raise RuntimeError("Cannot register Zstd dictionary for bitshuffle filter")
+    return dictionary_id
+
+
 HDF5PluginConfig = namedtuple(
     'HDF5PluginConfig',
     ('build_config', 'registered_filters'),
 )
 
 
-def get_config():
-    """Provides information about build configuration and filters registered by hdf5plugin.
+def get_simd():
+    """Returns the SIMD instruction sets selected at runtime by registered filters.
+
+    It maps the name of filters selecting their SIMD instruction set at runtime
+    (currently ``bshuf``) to the one in use (e.g., ``avx2``).
+
+    :rtype: Dict[str, str]
     """
+    simd = {}
+
+    info = registered_filters.get("bshuf")
+    if info is not None:
+        get_simd_func = info[1].bshuf_get_simd
+        get_simd_func.argtypes = []
+        get_simd_func.restype = ctypes.c_char_p
+        simd["bshuf"] = get_simd_func().decode('ascii')
+
+    return simd
+
+
+def get_config():
+    """Provides information about build configuration and filters registered by hdf5plugin."""
     filters = {}
     for name in FILTERS:
         info = registered_filters.get(name)
@@ -25,6 +25,7 @@
 """Provides tests """
 from __future__ import annotations
 
+import concurrent.futures
 import importlib.util
 import io
 import os
@@ -40,6 +41,11 @@ try:
 except ImportError:
     blosc2 = None
 
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
 from hdf5plugin import _filters
 
 
@@ -176,6 +182,147 @@ class TestHDF5PluginRW(BaseTestHDF5PluginRW):
                         filter_ = self._test('bshuf', dtype, compressed=cname != 'none', nelems=nelems, cname=cname)
                         self.assertEqual(filter_[2][3:5], (nelems, compression_id))
 
+        for cname in compressions.keys() - {'none'}:
+            with self.subTest(cname=cname, block_offsets=True):
+                filter_ = self._test('bshuf', numpy.int32, nelems=1024, cname=cname, block_offsets=True)
+                self.assertEqual(filter_[2][4:7], (compressions[cname], 0 if cname == 'lz4' else 3, 1))
+
+        for clevel in (-10, 1, 12):  # LZ4 acceleration and LZ4HC levels
+            with self.subTest(cname='lz4', clevel=clevel):
+                filter_ = self._test('bshuf', numpy.int32, cname='lz4', clevel=clevel)
+                self.assertEqual(numpy.array(filter_[2][5], dtype=numpy.uint32).view(numpy.int32), clevel)
+
+    @unittest.skipUnless(should_test("bshuf"), "Bitshuffle filter not available")
+    def testBitshuffleFletcher32(self):
+        """Write/read test with bitshuffle filter after Fletcher32 checksum"""
+        filename = os.path.join(self.tempdir, "test_bitshuffle_fletcher32.h5")
+        for cname in ('none', 'lz4', 'zstd'):
+            for dtype in (numpy.uint8, numpy.float64, numpy.dtype('S3')):
+                with self.subTest(cname=cname, dtype=dtype):
+                    data = numpy.arange(1003).astype(dtype)
+                    # Set filters explicitly to apply bitshuffle after Fletcher32
+                    compression = hdf5plugin.Bitshuffle(cname=cname, block_offsets=cname != 'none')
+                    dcpl = h5py.h5p.create(h5py.h5p.DATASET_CREATE)
+                    dcpl.set_chunk(data.shape)
+                    dcpl.set_fletcher32()
+                    dcpl.set_filter(
+                        compression.filter_id, h5py.h5z.FLAG_MANDATORY, compression.filter_options)
+                    with h5py.File(filename, "w") as f:
+                        dataset_id = h5py.h5d.create(
+                            f.id, b"data", h5py.h5t.py_create(data.dtype),
+                            h5py.h5s.create_simple(data.shape), dcpl=dcpl)
+                        dataset_id.write(h5py.h5s.ALL, h5py.h5s.ALL, data)
+                    with h5py.File(filename, "r") as f:
+                        plist = f["data"].id.get_create_plist()
+                        filter_ids = [plist.get_filter(i)[0] for i in range(plist.get_nfilters())]
+                        self.assertEqual(filter_ids, [h5py.h5z.FILTER_FLETCHER32, hdf5plugin.BSHUF_ID])
+                        self.assertTrue(numpy.array_equal(f["data"][()], data))
+                    os.remove(filename)
+
+    @unittest.skipUnless(should_test("bshuf"), "Bitshuffle filter not available")
+    def testBitshuffleDictionary(self):
+        """Write/read test with bitshuffle filter and a Zstd dictionary"""
+        with self.assertRaises(ValueError):
+            hdf5plugin.Bitshuffle(cname='lz4', dictionary=b"dictionary")
+        with self.assertRaises(ValueError):  # Not stored in a file
+            hdf5plugin.Bitshuffle(cname='zstd', dictionary=b"dictionary")
+        with self.assertRaises(RuntimeError):
+            hdf5plugin.register_bitshuffle_dictionary(b"not a zstd dictionary")
+
+        if zstandard is None:
+            self.skipTest("zstandard package not available")
+        rng = numpy.random.default_rng(seed=0)
+        samples = [
+            rng.integers(0, 100, size=2048, dtype=numpy.int32).cumsum().tobytes()
+            for _ in range(200)
+        ]
+        dictionary = zstandard.train_dictionary(8192, samples).as_bytes()
+        data = rng.integers(0, 100, size=(100, 2048), dtype=numpy.int32).cumsum(axis=1)
+
+        filename = os.path.join(self.tempdir, "test_bitshuffle_dictionary.h5")
+        with h5py.File(filename, "w") as f:
+            zstd_dictionary = hdf5plugin.store_bitshuffle_dictionary(
+                f, "zstd_dictionary", dictionary)
+            f.create_dataset(
+                "data", data=data, chunks=(10, 2048),
+                compression=hdf5plugin.Bitshuffle(cname='zstd', dictionary=zstd_dictionary))
+
+        with h5py.File(filename, "r") as f:
+            self.assertEqual(f["zstd_dictionary"][()].tobytes(), dictionary)
+            dictionary_id = hdf5plugin.register_bitshuffle_dictionary(f["zstd_dictionary"])
+            plist = f["data"].id.get_create_plist()
+            self.assertEqual(plist.get_filter(0)[2][7], dictionary_id)
+            self.assertTrue(numpy.array_equal(f["data"][()], data))
+        os.remove(filename)
+
+    @unittest.skipUnless(should_test("bshuf"), "Bitshuffle filter not available")
+    def testBitshuffleTruncatePlanes(self):
+        """Write/read test with bitshuffle filter and truncated bit planes"""
+        rng = numpy.random.default_rng(seed=0)
+        data = rng.integers(0, 2**16, size=(100, 1000), dtype=numpy.uint16)
+        filename = os.path.join(self.tempdir, "test_bitshuffle_truncate_planes.h5")
+        for truncate_planes in (0, 5, 16):
+            with self.subTest(truncate_planes=truncate_planes):
+                with h5py.File(filename, "w") as f:
+                    f.create_dataset(
+                        "data", data=data, chunks=(10, 1000),
+                        compression=hdf5plugin.Bitshuffle(truncate_planes=truncate_planes))
+                    f.create_dataset(
+                        "float", data=data.astype(numpy.float32), chunks=(10, 1000),
+                        compression=hdf5plugin.Bitshuffle(cname='zstd', truncate_planes=12))
+                with h5py.File(filename, "r") as f:
+                    plist = f["data"].id.get_create_plist()
+                    filter_ = plist.get_filter(0)
+                    if truncate_planes:
+                        self.assertEqual(filter_[2][8], truncate_planes)
+                    mask = numpy.uint16(0xFFFF << truncate_planes & 0xFFFF)
+                    self.assertTrue(numpy.array_equal(f["data"][()], data & mask))
+                    # float32 of uint16 values has at least 7 zero mantissa bits
+                    self.assertTrue(numpy.allclose(f["float"][()], data, rtol=2**-11))
+                os.remove(filename)
+
+        # Only the mantissa of floats can be truncated
+        with h5py.File(filename, "w") as f:
+            f.create_dataset(
+                "float", data=data.astype(numpy.float32), chunks=(10, 1000),
+                compression=hdf5plugin.Bitshuffle(truncate_planes=23))
+            self.assertTrue(numpy.all(f["float"][()] >= 0))
+            with self.assertRaises(ValueError):
+                f.create_dataset(
+                    "exponent", data=data.astype(numpy.float32), chunks=(10, 1000),
+                    compression=hdf5plugin.Bitshuffle(truncate_planes=24))
+        os.remove(filename)
+
+    @unittest.skipUnless(should_test("bshuf"), "Bitshuffle filter not available")
+    def testBitshuffleReadSlice(self):
+        """Read hyperslabs of bitshuffle compressed datasets"""
+        data = numpy.arange(20 * 30 * 40, dtype=numpy.float32).reshape(20, 30, 40)
+        filename = os.path.join(self.tempdir, "test_bitshuffle_read_slice.h5")
+        with h5py.File(filename, "w") as f:
+            f.create_dataset("lz4", data=data, chunks=(8, 30, 16),
+                             compression=hdf5plugin.Bitshuffle(nelems=64))
+            f.create_dataset("zstd_offsets", data=data, chunks=(8, 30, 16),
+                             compression=hdf5plugin.Bitshuffle(nelems=64, cname='zstd', block_offsets=True))
+            f.create_dataset("none", data=data, chunks=(8, 30, 16),
+                             compression=hdf5plugin.Bitshuffle(cname='none'))
+
+        selections = (
+            (slice(None), 5, slice(None)),
+            (slice(3, 17), slice(2, 25), slice(10, 38)),
+            (7,),
+            (-1, -1, slice(30, 10)),
+        )
+        with h5py.File(filename, "r") as f:
+            for name in ("lz4", "zstd_offsets", "none"):
+                for selection in selections:
+                    with self.subTest(dataset=name, selection=selection):
+                        saved = hdf5plugin.read_bitshuffle_slice(f[name], selection)
+                        self.assertTrue(numpy.array_equal(saved, data[selection]))
+
+            with self.assertRaises(ValueError):
+                hdf5plugin.read_bitshuffle_slice(f["lz4"], slice(0, 10, 2))
+        os.remove(filename)
+
     @unittest.skipUnless(should_test("blosc"), "Blosc filter not available")
     def testBlosc(self):
         """Write/read test with blosc filter plugin"""
@@ -203,6 +350,97 @@ class TestHDF5PluginRW(BaseTestHDF5PluginRW):
                         self.assertEqual(
                             filter_[2][4:], (clevel, shuffle, compression_id))
 
+    @unittest.skipUnless(should_test("blosc"), "Blosc filter not available")
+    def testBloscNThreads(self):
+        """Write/read test with blosc filter plugin using multiple threads"""
+        for nthreads in (1, 4):
+            with self.subTest(nthreads=nthreads):
+                filter_ = self._test('blosc', nthreads=nthreads)
+                self.assertEqual(filter_[2][7], nthreads)
+
+        for nthreads in (4, 1):
+            with self.subTest(set_nthreads=nthreads):
+                previous = hdf5plugin.set_nthreads(nthreads)
+                if previous is not None:
+                    self.addCleanup(hdf5plugin.set_nthreads, previous)
+                self._test('blosc')
+
+    @unittest.skipUnless(should_test("blosc"), "Blosc filter not available")
+    def testBloscBlocksizeSplitmode(self):
+        """Write/read test with blosc filter plugin with block size and split mode"""
+        for blocksize, splitmode in (
+            (256 * 1024, hdf5plugin.Blosc.ALWAYS_SPLIT),
+            (0, hdf5plugin.Blosc.NEVER_SPLIT),
+            (1024, 0),
+        ):
+            with self.subTest(blocksize=blocksize, splitmode=splitmode):
+                filter_ = self._test('blosc', blocksize=blocksize, splitmode=splitmode)
+                self.assertEqual(filter_[2][8], blocksize)
+                if splitmode:
+                    self.assertEqual(filter_[2][9], splitmode)
+
+    @unittest.skipUnless(should_test("blosc"), "Blosc filter not available")
+    def testBloscSplitmodeConcurrent(self):
+        """Write blosc datasets from concurrent threads with different split modes"""
+        data = numpy.arange(2**18, dtype=numpy.uint8) // 64
+        data[3::64] = numpy.random.default_rng(seed=0).integers(0, 256, size=data[3::64].shape)
+        data = data.view(numpy.uint32)
+        splitmodes = 0, hdf5plugin.Blosc.NEVER_SPLIT, hdf5plugin.Blosc.ALWAYS_SPLIT
+
+        def write(index):
+            splitmode = splitmodes[index % len(splitmodes)]
+            filename = os.path.join(self.tempdir, f"test_blosc_splitmode_{index}.h5")
+            with h5py.File(filename, "w") as f:
+                f.create_dataset(
+                    "data", data=data, chunks=data.shape,
+                    compression=hdf5plugin.Blosc(splitmode=splitmode))
+            with h5py.File(filename, "r") as f:
+                saved = f["data"][()]
+                chunk_size = f["data"].id.get_storage_size()
+            os.remove(filename)
+            return splitmode, numpy.array_equal(saved, data), chunk_size
+
+        sizes = {}
+        with concurrent.futures.ThreadPoolExecutor(max_workers=4) as executor:
+            for splitmode, equal, chunk_size in executor.map(write, range(24)):
+                self.assertTrue(equal)
+                # Each split mode gives the same chunk size whatever the others do
+                self.assertEqual(sizes.setdefault(splitmode, chunk_size), chunk_size)
+        self.assertNotEqual(sizes[0], sizes[hdf5plugin.Blosc.NEVER_SPLIT])
+
+    @unittest.skipUnless(should_test("blosc"), "Blosc filter not available")
+    def testBloscLargeChunks(self):
+        """Write/read blosc datasets with chunks larger than 8 MiB several times"""
+        data = numpy.arange(5 * 2**22, dtype=numpy.float32).reshape(5, 2**22)
+        filename = os.path.join(self.tempdir, "test_blosc_large_chunks.h5")
+        for _ in range(3):
+            with h5py.File(filename, "w") as f:
+                f.create_dataset(
+                    "data", data=data, chunks=(3, 2**22),  # 48 MiB chunks
+                    compression=hdf5plugin.Blosc())
+            with h5py.File(filename, "r") as f:
+                for _ in range(3):
+                    self.assertTrue(numpy.array_equal(f["data"][()], data))
+        os.remove(filename)
+
+    @unittest.skipUnless(should_test("blosc"), "Blosc filter not available")
+    def testBloscDecompressInPlace(self):
+        """Read blosc chunks stored in a buffer large enough for decompressed data"""
+        data = numpy.arange(2**16, dtype=numpy.int32)
+        filename = os.path.join(self.tempdir, "test_blosc_in_place.h5")
+        with h5py.File(filename, "w") as f:
+            f.create_dataset("data", data=data, chunks=data.shape, compression=hdf5plugin.Blosc())
+            filter_mask, chunk = f["data"].id.read_direct_chunk((0,))
+            # Pad the compressed chunk beyond the decompressed data size
+            padded = chunk + bytes(data.nbytes - len(chunk) + 16)
+            f.create_dataset(
+                "padded", shape=data.shape, dtype=data.dtype, chunks=data.shape,
+                compression=hdf5plugin.Blosc())
+            f["padded"].id.write_direct_chunk((0,), padded, filter_mask)
+        with h5py.File(filename, "r") as f:
+            self.assertTrue(numpy.array_equal(f["padded"][()], data))
+        os.remove(filename)
+
     @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
     def testBlosc2(self):
         """Write/read test with blosc2 filter plugin"""
@@ -235,6 +473,114 @@ class TestHDF5PluginRW(BaseTestHDF5PluginRW):
                             filter_params += (len(self._data_shape),) + self._data_shape
                         self.assertEqual(filter_[2][4:], filter_params)
 
+    @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
+    def testBlosc2NThreads(self):
+        """Write/read test with blosc2 filter plugin using multiple threads"""
+        for nthreads in (4, 1):
+            with self.subTest(set_nthreads=nthreads):
+                previous = hdf5plugin.set_nthreads(nthreads)
+                if previous is not None:
+                    self.addCleanup(hdf5plugin.set_nthreads, previous)
+                self._test('blosc2')
+
+        with self.assertRaises(ValueError):
+            hdf5plugin.set_nthreads(0)
+
+    @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
+    def testBlosc2RawChunk(self):
+        """Write/read test with blosc2 filter plugin storing bare chunks"""
+        for cname in ('blosclz', 'zstd'):
+            with self.subTest(cname=cname):
+                filter_ = self._test('blosc2', cname=cname, raw_chunk=True)
+                self.assertEqual(filter_[2][17], 1)
+
+    @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
+    def testBlosc2FilterPipeline(self):
+        """Write/read test with blosc2 filter plugin using a pipeline of filters"""
+        Blosc2 = hdf5plugin.Blosc2
+        for filters, expected in (
+            ([Blosc2.DELTA, Blosc2.BITSHUFFLE], (0, 0, 0, 0, 3, 2)),
+            ([Blosc2.SHUFFLE, (Blosc2.BYTEDELTA, 4)], (0, 0, 0, 0, 1, 35 | (4 << 8))),
+            ([(Blosc2.TRUNC_PREC, 10), Blosc2.SHUFFLE], (0, 0, 0, 0, 4 | (10 << 8), 1)),
+        ):
+            with self.subTest(filters=filters):
+                filter_ = self._test('blosc2', numpy.float32, lossless=False, filters=filters)
+                self.assertEqual(filter_[2][18:], expected)
+
+    @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
+    def testBlosc2Codecs(self):
+        """Write/read test with blosc2 filter plugin using codecs for multidimensional chunks"""
+        for cname, compression_id, dtype, codec_meta, expected_meta in (
+            ('ndlz', 32, numpy.uint8, 0, 4),
+            ('ndlz', 32, numpy.uint8, 8, 8),
+            ('zfp_acc', 33, numpy.float32, -3, 253),
+            ('zfp_prec', 34, numpy.float64, 20, 20),
+            ('zfp_rate', 35, numpy.float32, 50, 50),
+        ):
+            with self.subTest(cname=cname, codec_meta=codec_meta):
+                filter_ = self._test(
+                    'blosc2',
+                    dtype,
+                    lossless=cname == 'ndlz',
+                    cname=cname,
+                    filters=hdf5plugin.Blosc2.NOFILTER,
+                    codec_meta=codec_meta)
+                self.assertEqual(filter_[2][6], compression_id)
+                self.assertEqual(filter_[2][24], expected_meta)
+
+    def testBlosc2InvalidOptions(self):
+        """Test incompatible blosc2 filter options"""
+        Blosc2 = hdf5plugin.Blosc2
+        for options in (
+            dict(cname='ndlz', raw_chunk=True),
+            dict(cname='zfp_rate', codec_meta=50, raw_chunk=True),
+            dict(filters=Blosc2.NDCELL, raw_chunk=True),
+            dict(filters=[Blosc2.SHUFFLE, (Blosc2.NDMEAN, 4)], raw_chunk=True),
+            dict(access='slice_axis0', raw_chunk=True),
+            dict(cname='zstd', codec_meta=4),
+            dict(cname='ndlz', codec_meta=5),
+            dict(cname='zfp_rate', codec_meta=0),
+            dict(cname='zfp_rate', codec_meta=101),
+        ):
+            with self.subTest(**options):
+                with self.assertRaises(ValueError):
+                    Blosc2(**options)
+
+    @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
+    def testBlosc2Access(self):
+        """Write/read test with blosc2 filter plugin tuning blocks for an access pattern"""
+        for axis in (0, 1, 2):
+            with self.subTest(axis=axis):
+                filter_ = self._test('blosc2', access=f'slice_axis{axis}')
+                self.assertEqual(filter_[2][23:], (hdf5plugin.Blosc2.SHUFFLE, 0, 1 + axis))
+
+    @unittest.skipUnless(should_test("blosc2"), "Blosc2 filter not available")
+    def testBlosc2ReadSlice(self):
+        """Read hyperslabs of blosc2 compressed datasets"""
+        data = numpy.arange(20 * 30 * 40, dtype=numpy.float32).reshape(20, 30, 40)
+        filename = os.path.join(self.tempdir, "test_blosc2_read_slice.h5")
+        with h5py.File(filename, "w") as f:
+            f.create_dataset("b2nd", data=data, chunks=(8, 30, 16), compression=hdf5plugin.Blosc2())
+            f.create_dataset("raw_chunk", data=data, chunks=(8, 30, 16),
+                             compression=hdf5plugin.Blosc2(raw_chunk=True))
+
+        selections = (
+            (slice(None), 5, slice(None)),
+            (slice(3, 17), slice(2, 25), slice(10, 38)),
+            (7,),
+            (-1, -1, slice(30, 10)),
+        )
+        with h5py.File(filename, "r") as f:
+            for name in ("b2nd", "raw_chunk"):
+                for selection in selections:
+                    with self.subTest(dataset=name, selection=selection):
+                        saved = hdf5plugin.read_blosc2_slice(f[name], selection)
+                        self.assertTrue(numpy.array_equal(saved, data[selection]))
+
+            with self.assertRaises(ValueError):
+                hdf5plugin.read_blosc2_slice(f["b2nd"], slice(0, 10, 2))
+        os.remove(filename)
+
     @unittest.skipUnless(should_test("bzip2"), "BZip2 filter not available")
     def testBZip2(self):
         """Write/read test with BZip2 filter plugin"""
@@ -255,6 +601,31 @@ class TestHDF5PluginRW(BaseTestHDF5PluginRW):
         filter_ = self._test('lz4', nbytes=1024)
         self.assertEqual(filter_[2], (1024,))
 
+        for clevel in (-10, 1, 12):  # LZ4 acceleration and LZ4HC levels
+            with self.subTest(clevel=clevel):
+                filter_ = self._test('lz4', nbytes=1024, clevel=clevel)
+                self.assertEqual(numpy.array(filter_[2][2], dtype=numpy.uint32).view(numpy.int32), clevel)
+
+        # Blocks are processed in parallel: mix compressible and random blocks
+        data = numpy.arange(100000, dtype=numpy.int32)
+        data[::3] = numpy.random.default_rng(seed=0).integers(0, 2**31, size=data[::3].shape)
+        filename = os.path.join(self.tempdir, "test_lz4_blocks.h5")
+        with h5py.File(filename, "w") as f:
+            f.create_dataset("data", data=data, compression=hdf5plugin.LZ4(nbytes=10000))
+        with h5py.File(filename, "r") as f:
+            self.assertTrue(numpy.array_equal(f["data"][()], data))
+
+        # Truncated or corrupted chunks are rejected
+        with h5py.File(filename, "a") as f:
+            dataset = f.create_dataset(
+                "corrupted", data=data, chunks=data.shape, compression=hdf5plugin.LZ4(nbytes=10000))
+            chunk = bytearray(dataset.id.read_direct_chunk((0,))[1])
+            dataset.id.write_direct_chunk((0,), bytes(chunk[:len(chunk) // 2]))
+        with h5py.File(filename, "r") as f:
+            with self.assertRaises(OSError):
+                f["corrupted"][()]
+        os.remove(filename)
+
     @unittest.skipUnless(should_test("fcidecomp"), "FCIDECOMP filter not available")
     def testFciDecomp(self):
         """Write/read test with fcidecomp filter plugin"""
@@ -328,13 +699,18 @@ class TestHDF5PluginRW(BaseTestHDF5PluginRW):
         self._test('zstd')
         tests = [
             {'clevel': 3},
-            {'clevel': 22}
+            {'clevel': 22},
+            {'clevel': 19, 'nworkers': 2, 'job_size': 2**20},
+            {'clevel': 3, 'long_distance_matching': True, 'window_log': 28},
         ]
         for options in tests:
             for dtype in (numpy.float32, numpy.float64):
                 with self.subTest(options=options, dtype=dtype):
                     self._test('zstd', dtype=dtype, **options)
 
+        filter_ = self._test('zstd', clevel=19, nworkers=2)
+        self.assertEqual(filter_[2], (19, 2))
+
 
 class TestPackage(unittest.TestCase):
     """Test general features of the hdf5plugin package"""
@@ -366,6 +742,13 @@ class TestPackage(unittest.TestCase):
         self.assertIsInstance(config.build_config.embedded_filters, tuple)
         self.assertIsInstance(config.registered_filters, dict)
 
+    def testGetSimd(self):
+        """Test hdf5plugin.get_simd"""
+        simd = hdf5plugin.get_simd()
+        self.assertIsInstance(simd, dict)
+        if "bshuf" in simd:
+            self.assertIn(simd["bshuf"], ("avx512", "avx2", "sse2", "neon", "scalar"))
+
     def testVersion(self):
         """Test version information"""
         self.assertIsInstance(hdf5plugin.version, str)